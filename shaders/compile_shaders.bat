@@ -1,3 +1,12 @@
-C:\VulkanSDK\1.3.250.1\Bin\glslangValidator.exe -V ..\shaders\shader.vert -o ..\src\shaders\vert.spv
-C:\VulkanSDK\1.3.250.1\Bin\glslangValidator.exe -V ..\shaders\shader.frag -o ..\src\shaders\frag.spv
-C:\VulkanSDK\1.3.250.1\Bin\glslangValidator.exe -V ..\shaders\shader.comp -o ..\src\shaders\comp.spv
\ No newline at end of file
+C:\VulkanSDK\1.3.250.1\Bin\glslangValidator.exe -V --target-env vulkan1.1 ..\shaders\shader.vert -o ..\src\shaders\vert.spv
+C:\VulkanSDK\1.3.250.1\Bin\glslangValidator.exe -V --target-env vulkan1.1 ..\shaders\shader.frag -o ..\src\shaders\frag.spv
+C:\VulkanSDK\1.3.250.1\Bin\glslangValidator.exe -V --target-env vulkan1.1 ..\shaders\shader.comp -o ..\src\shaders\comp.spv
+C:\VulkanSDK\1.3.250.1\Bin\glslangValidator.exe -V --target-env vulkan1.1 ..\shaders\packed.comp -o ..\src\shaders\packed.comp.spv
+C:\VulkanSDK\1.3.250.1\Bin\glslangValidator.exe -V --target-env vulkan1.1 ..\shaders\expand.comp -o ..\src\shaders\expand.comp.spv
+C:\VulkanSDK\1.3.250.1\Bin\glslangValidator.exe -V --target-env vulkan1.1 ..\shaders\activity.comp -o ..\src\shaders\activity.comp.spv
+C:\VulkanSDK\1.3.250.1\Bin\glslangValidator.exe -V --target-env vulkan1.1 ..\shaders\rangeColumns.comp -o ..\src\shaders\rangeColumns.comp.spv
+C:\VulkanSDK\1.3.250.1\Bin\glslangValidator.exe -V --target-env vulkan1.1 ..\shaders\rangeRows.comp -o ..\src\shaders\rangeRows.comp.spv
+C:\VulkanSDK\1.3.250.1\Bin\glslangValidator.exe -V --target-env vulkan1.1 ..\shaders\snapshot.comp -o ..\src\shaders\snapshot.comp.spv
+C:\VulkanSDK\1.3.250.1\Bin\glslangValidator.exe -V --target-env vulkan1.1 ..\shaders\restore.comp -o ..\src\shaders\restore.comp.spv
+C:\VulkanSDK\1.3.250.1\Bin\glslangValidator.exe -V --target-env vulkan1.1 ..\shaders\delta.comp -o ..\src\shaders\delta.comp.spv
+C:\VulkanSDK\1.3.250.1\Bin\glslangValidator.exe -V --target-env vulkan1.1 ..\shaders\initialize.comp -o ..\src\shaders\initialize.comp.spv
\ No newline at end of file
@@ -1,3 +1,12 @@
-glslc shaders/shader.frag -o shaders/frag.spv
-glslc shaders/shader.comp -o shaders/comp.spv
-glslc shaders/shader.vert -o shaders/vert.spv
+glslc --target-env=vulkan1.1 shaders/shader.frag -o shaders/frag.spv
+glslc --target-env=vulkan1.1 shaders/shader.comp -o shaders/comp.spv
+glslc --target-env=vulkan1.1 shaders/shader.vert -o shaders/vert.spv
+glslc --target-env=vulkan1.1 shaders/packed.comp -o shaders/packed.comp.spv
+glslc --target-env=vulkan1.1 shaders/expand.comp -o shaders/expand.comp.spv
+glslc --target-env=vulkan1.1 shaders/activity.comp -o shaders/activity.comp.spv
+glslc --target-env=vulkan1.1 shaders/rangeColumns.comp -o shaders/rangeColumns.comp.spv
+glslc --target-env=vulkan1.1 shaders/rangeRows.comp -o shaders/rangeRows.comp.spv
+glslc --target-env=vulkan1.1 shaders/snapshot.comp -o shaders/snapshot.comp.spv
+glslc --target-env=vulkan1.1 shaders/restore.comp -o shaders/restore.comp.spv
+glslc --target-env=vulkan1.1 shaders/delta.comp -o shaders/delta.comp.spv
+glslc --target-env=vulkan1.1 shaders/initialize.comp -o shaders/initialize.comp.spv
@@ -0,0 +1,11 @@
+// World::UniformBufferObject, written by Memory::updateUniformBuffer. Shared
+// by the compute shaders that only need the grid dimensions.
+layout (binding = 0) uniform ParameterUBO {
+    vec4 lightDirection;
+    ivec2 gridDimensions;
+    float gridHeight;
+    float cellSize;
+    mat4 model;
+    mat4 view;
+    mat4 projection;
+} ubo;
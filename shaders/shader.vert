@@ -1,10 +1,8 @@
 #version 450
 layout(location = 0) in vec4 inPosition;
-layout(location = 1) in vec4 inColor;
-layout(location = 2) in vec4 inSize;
-layout(location = 3) in ivec4 inStates;
-layout(location = 4) in vec4 inTileSidesHeight;
-layout(location = 5) in vec4 inTileCornersHeight;
+layout(location = 1) in uint inState;
+layout(location = 2) in vec4 inTileSidesHeight;
+layout(location = 3) in vec4 inTileCornersHeight;
 
 layout (binding = 0) uniform ParameterUBO {
     vec4 light;
@@ -21,6 +19,28 @@ mat4 model = ubo.model;
 mat4 view = ubo.view;
 mat4 projection = ubo.projection;
 
+// Color and size are derived from the packed state written by shader.comp
+const vec4 red        = vec4(1.0, 0.0, 0.0, 1.0);
+const vec4 blue       = vec4(0.0, 0.0, 1.0, 1.0);
+const vec4 white      = vec4(1.0, 1.0, 1.0, 1.0);
+const vec4 grey1      = vec4(0.5, 0.5, 0.5, 1.0);
+const float cycleSize = 24.0;
+
+bool aliveState  = (inState & 0x1u) != 0u;
+bool seededState = (inState & 0x80u) != 0u;
+float cycle      = float((inState >> 2u) & 0x1Fu);
+
+vec4 cellColor() {
+    if (seededState) { return aliveState ? blue : red; }
+    if (!aliveState) { return grey1; }
+    // Red increment accumulated over the cycle, one step per passed hour
+    float increment = cycle * (cycle + 1.0) / (2.0 * cycleSize * 50.0);
+    return white + vec4(increment, vec3(0.0));
+}
+
+vec4 inColor = cellColor();
+vec4 inSize  = vec4(seededState || aliveState ? ubo.cellSize : 0.0);
+
 vec4 matchHeight(vec4 targetHeight, float multiplyBy ){
     vec4 myHeight = vec4(inPosition.z);
     int toVertexScale = 10;  
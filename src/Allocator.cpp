@@ -0,0 +1,318 @@
+#include <algorithm>
+
+#include "Allocator.h"
+#include "CapitalEngine.h"
+
+namespace {
+VkDeviceSize alignUp(VkDeviceSize offset, VkDeviceSize alignment) {
+  return alignment > 1 ? (offset + alignment - 1) / alignment * alignment
+                       : offset;
+}
+}  // namespace
+
+Allocator::Allocator() : memoryProperties{}, usageBytes{} {
+  _log.console("{ ALC }", "constructing Allocator");
+}
+
+Allocator::~Allocator() {
+  _log.console("{ ALC }", "destructing Allocator");
+}
+
+// Memory for a resource of the given requirements, bound by the caller at
+// allocation.offset of allocation.memory
+Allocator::Allocation Allocator::allocate(
+    const VkMemoryRequirements& requirements,
+    uint32_t memoryTypeIndex,
+    Kind kind,
+    Usage usage) {
+  const uint32_t poolIndex = getPool(memoryTypeIndex, kind);
+  Pool& pool = pools[poolIndex];
+  Allocation allocation{
+      .size = requirements.size, .pool = poolIndex, .usage = usage};
+  usageBytes[static_cast<size_t>(usage)] += requirements.size;
+
+  if (requirements.size >= pool.blockSize / 2) {
+    allocation.memory = allocateMemory(requirements.size, memoryTypeIndex,
+                                       pool.hostVisible, allocation.mapped);
+    pool.dedicatedCount++;
+    pool.dedicatedBytes += requirements.size;
+    return allocation;
+  }
+
+  for (uint32_t i = 0; i < pool.blocks.size(); i++) {
+    if (pool.blocks[i].memory != VK_NULL_HANDLE &&
+        allocateFromBlock(pool, i, requirements, allocation)) {
+      return allocation;
+    }
+  }
+
+  // Slots of released blocks are reused, allocations keep their index
+  uint32_t blockIndex = 0;
+  while (blockIndex < pool.blocks.size() &&
+         pool.blocks[blockIndex].memory != VK_NULL_HANDLE) {
+    blockIndex++;
+  }
+  if (blockIndex == pool.blocks.size()) {
+    pool.blocks.emplace_back();
+  }
+  Block& block = pool.blocks[blockIndex];
+  block = Block{.size = pool.blockSize};
+  block.memory = allocateMemory(pool.blockSize, memoryTypeIndex,
+                                pool.hostVisible, block.mapped);
+  if (pool.strategy == Strategy::freeList) {
+    block.freeRanges[0] = pool.blockSize;
+  }
+  allocateFromBlock(pool, blockIndex, requirements, allocation);
+  return allocation;
+}
+
+// Returns the memory and clears allocation, freeing nothing twice. A block
+// left empty is released unless it is the pool's only empty block.
+void Allocator::free(Allocation& allocation) {
+  if (allocation.memory == VK_NULL_HANDLE) {
+    return;
+  }
+  Pool& pool = pools[allocation.pool];
+  usageBytes[static_cast<size_t>(allocation.usage)] -= allocation.size;
+
+  if (allocation.block == dedicated) {
+    vkFreeMemory(_mechanics.mainDevice.logical, allocation.memory,
+                 _telemetry.getCallbacks());
+    pool.dedicatedCount--;
+    pool.dedicatedBytes -= allocation.size;
+    allocation = Allocation{};
+    return;
+  }
+
+  Block& block = pool.blocks[allocation.block];
+  releaseToBlock(pool.strategy, block, allocation);
+  if (block.allocationCount == 0) {
+    const bool otherEmptyBlock = std::any_of(
+        pool.blocks.begin(), pool.blocks.end(), [&](const Block& other) {
+          return &other != &block && other.memory != VK_NULL_HANDLE &&
+                 other.allocationCount == 0;
+        });
+    if (otherEmptyBlock) {
+      vkFreeMemory(_mechanics.mainDevice.logical, block.memory,
+                   _telemetry.getCallbacks());
+      block = Block{};
+    }
+  }
+  allocation = Allocation{};
+}
+
+// Releases every block, call once all resources are destroyed and before the
+// device is
+void Allocator::destroy() {
+  uint32_t leaked = 0;
+  for (Pool& pool : pools) {
+    leaked += pool.dedicatedCount;
+    for (Block& block : pool.blocks) {
+      if (block.memory != VK_NULL_HANDLE) {
+        leaked += block.allocationCount;
+        vkFreeMemory(_mechanics.mainDevice.logical, block.memory,
+                     _telemetry.getCallbacks());
+      }
+    }
+  }
+  if (leaked > 0) {
+    _log.console("{ ALC }", leaked, "allocations were never freed");
+  }
+  pools.clear();
+}
+
+Allocator::Statistics Allocator::getStatistics() const {
+  Statistics statistics{.usageBytes = usageBytes};
+  for (const Pool& pool : pools) {
+    addStatistics(pool, statistics);
+  }
+  return statistics;
+}
+
+// One line per pool, fragmentation being the share of free block memory
+// outside the largest free range
+void Allocator::logStatistics() const {
+  const Statistics total = getStatistics();
+  _log.console("{ ALC }", total.allocationCount, "allocations in",
+               total.blockCount, "blocks and", total.dedicatedCount,
+               "dedicated allocations");
+  for (const Pool& pool : pools) {
+    Statistics statistics{};
+    addStatistics(pool, statistics);
+    const VkDeviceSize freeBytes = statistics.blockBytes - statistics.usedBytes;
+    const double fragmentation =
+        freeBytes > 0 ? 100.0 * (1.0 - static_cast<double>(
+                                           statistics.largestFreeRange) /
+                                           freeBytes)
+                      : 0.0;
+    _log.console(_log.style.charLeader, "memory type", pool.memoryTypeIndex,
+                 pool.kind == Kind::image ? "images," : "buffers,",
+                 statistics.usedBytes, "of", statistics.blockBytes,
+                 "block bytes used,", statistics.dedicatedBytes,
+                 "dedicated,", statistics.freeRangeCount, "free ranges,",
+                 fragmentation, "% fragmented");
+  }
+}
+
+uint32_t Allocator::getPool(uint32_t memoryTypeIndex, Kind kind) {
+  for (uint32_t i = 0; i < pools.size(); i++) {
+    if (pools[i].memoryTypeIndex == memoryTypeIndex && pools[i].kind == kind) {
+      return i;
+    }
+  }
+  if (memoryProperties.memoryTypeCount == 0) {
+    vkGetPhysicalDeviceMemoryProperties(_mechanics.mainDevice.physical,
+                                        &memoryProperties);
+  }
+
+  // Small heaps get smaller blocks, so a few of them cannot exhaust the heap
+  const VkMemoryType& type = memoryProperties.memoryTypes[memoryTypeIndex];
+  const VkDeviceSize heapSize =
+      memoryProperties.memoryHeaps[type.heapIndex].size;
+  const bool hostVisible =
+      (type.propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+  const bool deviceLocal =
+      (type.propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) != 0;
+  pools.push_back(
+      {.memoryTypeIndex = memoryTypeIndex,
+       .kind = kind,
+       .strategy = hostVisible && !deviceLocal ? Strategy::linear
+                                               : Strategy::freeList,
+       .blockSize = heapSize <= (1ull << 30) ? heapSize / 8
+                                             : preferredBlockSize,
+       .hostVisible = hostVisible});
+  return static_cast<uint32_t>(pools.size() - 1);
+}
+
+// First fit in a free list block, at the top of a linear one
+bool Allocator::allocateFromBlock(Pool& pool,
+                                  uint32_t blockIndex,
+                                  const VkMemoryRequirements& requirements,
+                                  Allocation& allocation) {
+  Block& block = pool.blocks[blockIndex];
+  VkDeviceSize offset = 0;
+
+  if (pool.strategy == Strategy::linear) {
+    offset = alignUp(block.top, requirements.alignment);
+    if (offset + requirements.size > block.size) {
+      return false;
+    }
+    block.liveRanges[offset] = offset + requirements.size;
+    block.top = offset + requirements.size;
+  } else {
+    auto range = std::find_if(
+        block.freeRanges.begin(), block.freeRanges.end(), [&](auto& free) {
+          return alignUp(free.first, requirements.alignment) +
+                     requirements.size <=
+                 free.first + free.second;
+        });
+    if (range == block.freeRanges.end()) {
+      return false;
+    }
+    const VkDeviceSize rangeBegin = range->first;
+    const VkDeviceSize rangeEnd = range->first + range->second;
+    offset = alignUp(rangeBegin, requirements.alignment);
+    block.freeRanges.erase(range);
+    if (offset > rangeBegin) {
+      block.freeRanges[rangeBegin] = offset - rangeBegin;
+    }
+    if (offset + requirements.size < rangeEnd) {
+      block.freeRanges[offset + requirements.size] =
+          rangeEnd - offset - requirements.size;
+    }
+  }
+
+  block.allocationCount++;
+  block.usedBytes += requirements.size;
+  allocation.memory = block.memory;
+  allocation.offset = offset;
+  allocation.block = blockIndex;
+  allocation.mapped =
+      block.mapped ? static_cast<char*>(block.mapped) + offset : nullptr;
+  return true;
+}
+
+// A linear block rewinds to the end of its highest live allocation, a free
+// list block merges the range with its free neighbours
+void Allocator::releaseToBlock(Strategy strategy,
+                               Block& block,
+                               const Allocation& allocation) {
+  block.allocationCount--;
+  block.usedBytes -= allocation.size;
+
+  if (strategy == Strategy::freeList) {
+    VkDeviceSize begin = allocation.offset;
+    VkDeviceSize end = allocation.offset + allocation.size;
+    auto next = block.freeRanges.lower_bound(begin);
+    if (next != block.freeRanges.end() && next->first == end) {
+      end += next->second;
+      next = block.freeRanges.erase(next);
+    }
+    if (next != block.freeRanges.begin()) {
+      auto previous = std::prev(next);
+      if (previous->first + previous->second == begin) {
+        begin = previous->first;
+        block.freeRanges.erase(previous);
+      }
+    }
+    block.freeRanges[begin] = end - begin;
+    return;
+  }
+
+  block.liveRanges.erase(allocation.offset);
+  block.top =
+      block.liveRanges.empty() ? 0 : block.liveRanges.rbegin()->second;
+}
+
+VkDeviceMemory Allocator::allocateMemory(VkDeviceSize size,
+                                         uint32_t memoryTypeIndex,
+                                         bool hostVisible,
+                                         void*& mapped) {
+  VkMemoryAllocateInfo allocateInfo{
+      .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+      .allocationSize = size,
+      .memoryTypeIndex = memoryTypeIndex};
+
+  VkDeviceMemory memory;
+  _mechanics.result(vkAllocateMemory, _mechanics.mainDevice.logical,
+                    &allocateInfo, _telemetry.getCallbacks(), &memory);
+  mapped = nullptr;
+  if (hostVisible) {
+    _mechanics.result(vkMapMemory, _mechanics.mainDevice.logical, memory, 0,
+                      VK_WHOLE_SIZE, 0, &mapped);
+  }
+  return memory;
+}
+
+void Allocator::addStatistics(const Pool& pool,
+                              Statistics& statistics) const {
+  const uint32_t heapIndex =
+      memoryProperties.memoryTypes[pool.memoryTypeIndex].heapIndex;
+  statistics.dedicatedCount += pool.dedicatedCount;
+  statistics.dedicatedBytes += pool.dedicatedBytes;
+  statistics.allocationCount += pool.dedicatedCount;
+  statistics.heapBytes[heapIndex] += pool.dedicatedBytes;
+  for (const Block& block : pool.blocks) {
+    if (block.memory == VK_NULL_HANDLE) {
+      continue;
+    }
+    statistics.blockCount++;
+    statistics.blockBytes += block.size;
+    statistics.heapBytes[heapIndex] += block.size;
+    statistics.usedBytes += block.usedBytes;
+    statistics.allocationCount += block.allocationCount;
+    if (pool.strategy == Strategy::linear) {
+      if (block.top < block.size) {
+        statistics.freeRangeCount++;
+        statistics.largestFreeRange =
+            std::max(statistics.largestFreeRange, block.size - block.top);
+      }
+      continue;
+    }
+    for (const auto& [offset, size] : block.freeRanges) {
+      statistics.freeRangeCount++;
+      statistics.largestFreeRange =
+          std::max(statistics.largestFreeRange, size);
+    }
+  }
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "vulkan/vulkan.h"
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+// Sub-allocates buffers and images from a few large blocks per memory type
+// instead of one vkAllocateMemory each, which runs into
+// maxMemoryAllocationCount and pays the allocation latency every time.
+// Buffers and images keep to separate blocks, so bufferImageGranularity never
+// matters. Device local blocks keep a list of free ranges and merge them
+// again when freed. Host visible blocks hold staging and readback buffers
+// that mostly live briefly, they are filled front to back and rewind when
+// their last allocations are freed. Resources of half a block or more get
+// memory of their own. Host visible memory stays mapped.
+class Allocator {
+ public:
+  Allocator();
+  ~Allocator();
+
+  enum class Kind { buffer, image };
+  // What the memory holds, see MemoryTelemetry
+  enum class Usage {
+    simulation,
+    uniforms,
+    parameters,
+    attachments,
+    staging,
+    cpuMirror
+  };
+  inline static const size_t usageCount{6};
+
+  struct Allocation {
+    VkDeviceMemory memory{VK_NULL_HANDLE};
+    VkDeviceSize offset{0};
+    VkDeviceSize size{0};
+    // Host visible memory at offset, otherwise nullptr
+    void* mapped{nullptr};
+    uint32_t pool{0};
+    // Index into the pool's blocks, dedicated memory has none
+    uint32_t block{dedicated};
+    Usage usage{Usage::simulation};
+  };
+
+  struct Statistics {
+    uint32_t blockCount{0};
+    uint32_t dedicatedCount{0};
+    uint32_t allocationCount{0};
+    VkDeviceSize blockBytes{0};
+    VkDeviceSize dedicatedBytes{0};
+    VkDeviceSize usedBytes{0};
+    uint32_t freeRangeCount{0};
+    VkDeviceSize largestFreeRange{0};
+    // Bytes of resources by Usage, and of blocks and dedicated memory by heap
+    std::array<VkDeviceSize, usageCount> usageBytes{};
+    std::array<VkDeviceSize, VK_MAX_MEMORY_HEAPS> heapBytes{};
+  };
+
+ public:
+  Allocation allocate(const VkMemoryRequirements& requirements,
+                      uint32_t memoryTypeIndex,
+                      Kind kind,
+                      Usage usage);
+  void free(Allocation& allocation);
+  void destroy();
+
+  Statistics getStatistics() const;
+  void logStatistics() const;
+
+ private:
+  inline static const uint32_t dedicated{UINT32_MAX};
+  inline static const VkDeviceSize preferredBlockSize{256ull << 20};
+
+  enum class Strategy { freeList, linear };
+
+  struct Block {
+    VkDeviceMemory memory{VK_NULL_HANDLE};
+    VkDeviceSize size{0};
+    void* mapped{nullptr};
+    uint32_t allocationCount{0};
+    VkDeviceSize usedBytes{0};
+    // Free list: offset to size of every free range, merged when adjacent
+    std::map<VkDeviceSize, VkDeviceSize> freeRanges;
+    // Linear: end of the last allocation and the ends of those below it
+    VkDeviceSize top{0};
+    std::map<VkDeviceSize, VkDeviceSize> liveRanges;
+  };
+
+  // The blocks of one memory type and kind of resource
+  struct Pool {
+    uint32_t memoryTypeIndex;
+    Kind kind;
+    Strategy strategy;
+    VkDeviceSize blockSize;
+    bool hostVisible;
+    std::vector<Block> blocks;
+    uint32_t dedicatedCount{0};
+    VkDeviceSize dedicatedBytes{0};
+  };
+
+  VkPhysicalDeviceMemoryProperties memoryProperties;
+  std::vector<Pool> pools;
+  std::array<VkDeviceSize, usageCount> usageBytes;
+
+  uint32_t getPool(uint32_t memoryTypeIndex, Kind kind);
+  bool allocateFromBlock(Pool& pool,
+                         uint32_t blockIndex,
+                         const VkMemoryRequirements& requirements,
+                         Allocation& allocation);
+  void releaseToBlock(Strategy strategy,
+                      Block& block,
+                      const Allocation& allocation);
+  VkDeviceMemory allocateMemory(VkDeviceSize size,
+                                uint32_t memoryTypeIndex,
+                                bool hostVisible,
+                                void*& mapped);
+  void addStatistics(const Pool& pool, Statistics& statistics) const;
+};
@@ -0,0 +1,217 @@
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Sweeps CapitalEngine --headless over grid sizes, densities, workgroup sizes
+// and backends. Every configuration runs in its own engine process so device
+// memory and pipelines start fresh, the engine appends one JSON line per run
+// to a report that is collected into the output file. Given a baseline from an
+// earlier sweep, generations/s of matching configurations are compared and
+// the exit code is non zero when any run regressed past the tolerance.
+
+namespace {
+struct Options {
+  std::vector<std::string> sizes{"128", "256", "512"};
+  std::vector<std::string> densities{"0.2"};
+  std::vector<std::string> workgroups{"16", "32"};
+  std::vector<std::string> backends{"cells", "packed", "cpu"};
+  std::string generations{"1000"};
+  std::string output{"benchmark.json"};
+  std::string baseline;
+  double tolerance{0.05};
+};
+
+std::vector<std::string> split(const std::string& list) {
+  std::vector<std::string> values;
+  std::stringstream stream(list);
+  std::string value;
+  while (std::getline(stream, value, ',')) {
+    if (!value.empty()) {
+      values.push_back(value);
+    }
+  }
+  return values;
+}
+
+Options parseArguments(int argc, char* argv[]) {
+  Options options;
+  for (int i = 1; i < argc; i++) {
+    const std::string argument = argv[i];
+    if (i + 1 >= argc) {
+      throw std::runtime_error("\n!ERROR! Missing value for " + argument);
+    }
+    const std::string value = argv[++i];
+
+    if (argument == "--sizes") {
+      options.sizes = split(value);
+    } else if (argument == "--densities") {
+      options.densities = split(value);
+    } else if (argument == "--workgroups") {
+      options.workgroups = split(value);
+    } else if (argument == "--backends") {
+      options.backends = split(value);
+    } else if (argument == "--generations") {
+      options.generations = value;
+    } else if (argument == "--output") {
+      options.output = value;
+    } else if (argument == "--baseline") {
+      options.baseline = value;
+    } else if (argument == "--tolerance") {
+      options.tolerance = std::stod(value);
+    } else {
+      throw std::runtime_error("\n!ERROR! Unknown argument " + argument);
+    }
+  }
+  return options;
+}
+
+// Value of a key in one report line, the engine writes flat objects only.
+// Strings are returned as written, escapes included.
+std::string getValue(const std::string& line, const std::string& key) {
+  const std::string pattern = "\"" + key + "\": ";
+  const size_t start = line.find(pattern);
+  if (start == std::string::npos) {
+    return "";
+  }
+  size_t begin = start + pattern.size();
+  if (line[begin] == '"') {
+    begin++;
+    size_t end = begin;
+    while (end < line.size() && line[end] != '"') {
+      end += line[end] == '\\' ? 2 : 1;
+    }
+    return line.substr(begin, end - begin);
+  }
+  return line.substr(begin, line.find_first_of(",}", begin) - begin);
+}
+
+// Results of other devices never count as a baseline
+std::string getConfiguration(const std::string& line) {
+  return getValue(line, "device") + " " + getValue(line, "backend") + " " +
+         getValue(line, "width") + "x" +
+         getValue(line, "height") + " alive " + getValue(line, "alive") +
+         " workgroup " + getValue(line, "workgroup");
+}
+
+std::vector<std::string> readResults(const std::string& path) {
+  std::ifstream file(path);
+  if (!file) {
+    throw std::runtime_error("\n!ERROR! failed to open " + path);
+  }
+  std::vector<std::string> results;
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.find("\"backend\"") != std::string::npos) {
+      results.push_back(line.substr(line.find('{')));
+      results.back().erase(results.back().rfind('}') + 1);
+    }
+  }
+  return results;
+}
+
+void writeResults(const std::string& path,
+                  const std::vector<std::string>& results) {
+  std::ofstream file(path);
+  if (!file) {
+    throw std::runtime_error("\n!ERROR! failed to open " + path);
+  }
+  file << "{\"results\": [\n";
+  for (size_t i = 0; i < results.size(); i++) {
+    file << "  " << results[i] << (i + 1 < results.size() ? ",\n" : "\n");
+  }
+  file << "]}\n";
+}
+
+// Returns the number of configurations slower than the baseline by more than
+// the tolerance
+int compareWithBaseline(const std::vector<std::string>& results,
+                        const std::string& baselinePath,
+                        double tolerance) {
+  std::map<std::string, double> baseline;
+  for (const std::string& line : readResults(baselinePath)) {
+    baseline[getConfiguration(line)] =
+        std::stod(getValue(line, "generationsPerSecond"));
+  }
+
+  int regressions = 0;
+  for (const std::string& line : results) {
+    const std::string configuration = getConfiguration(line);
+    const auto reference = baseline.find(configuration);
+    if (reference == baseline.end() || reference->second <= 0.0) {
+      continue;
+    }
+    const double rate = std::stod(getValue(line, "generationsPerSecond"));
+    const double change = rate / reference->second - 1.0;
+    const bool regressed = change < -tolerance;
+    regressions += regressed;
+    std::cout << (regressed ? "  REGRESSION " : "  ") << configuration << ": "
+              << reference->second << " -> " << rate << " generations/s ("
+              << change * 100.0 << "%)\n";
+  }
+  return regressions;
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  try {
+    const Options options = parseArguments(argc, argv);
+    const std::filesystem::path engine =
+        std::filesystem::path(argv[0]).parent_path() / "CapitalEngine";
+    const std::filesystem::path report =
+        std::filesystem::temp_directory_path() / "CapitalBench.jsonl";
+    std::filesystem::remove(report);
+
+    for (const std::string& backend : options.backends) {
+      for (const std::string& size : options.sizes) {
+        for (const std::string& density : options.densities) {
+          // The CPU backend has no workgroups, run it once per grid
+          const std::vector<std::string> workgroups =
+              backend == "cpu" ? std::vector<std::string>{"1"}
+                               : options.workgroups;
+          for (const std::string& workgroup : workgroups) {
+            const std::string command =
+                "\"" + engine.string() + "\" --headless " +
+                options.generations + " --backend " + backend + " --grid " +
+                size + "x" + size + " --density " + density +
+                " --workgroup " + workgroup + " --report \"" +
+                report.string() + "\"";
+            std::cout << "{ Bench } " << backend << " " << size << "x"
+                      << size << " density " << density << " workgroup "
+                      << workgroup << std::endl;
+            if (std::system(command.c_str()) != 0) {
+              std::cout << "  run failed, skipping" << std::endl;
+            }
+          }
+        }
+      }
+    }
+
+    const std::vector<std::string> results =
+        std::filesystem::exists(report) ? readResults(report.string())
+                                        : std::vector<std::string>{};
+    writeResults(options.output, results);
+    std::filesystem::remove(report);
+    std::cout << "{ Bench } " << results.size() << " results written to "
+              << options.output << std::endl;
+
+    if (!options.baseline.empty()) {
+      const int regressions = compareWithBaseline(results, options.baseline,
+                                                  options.tolerance);
+      std::cout << "{ Bench } " << regressions << " regressions against "
+                << options.baseline << std::endl;
+      if (regressions > 0) {
+        return EXIT_FAILURE;
+      }
+    }
+  } catch (const std::exception& e) {
+    std::cout << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
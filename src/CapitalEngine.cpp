@@ -1,3 +1,5 @@
+#include <chrono>
+#include <fstream>
 #include <iostream>
 
 #include "CapitalEngine.h"
@@ -7,12 +9,49 @@
 #include "Pipelines.h"
 #include "Window.h"
 
+namespace {
+// Quotes, backslashes and control characters of a JSON string value
+std::string escapeJson(const std::string& text) {
+  std::string escaped;
+  for (const char c : text) {
+    if (c == '"' || c == '\\') {
+      escaped += '\\';
+      escaped += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      static const char* digits = "0123456789abcdef";
+      escaped += "\\u00";
+      escaped += digits[c >> 4];
+      escaped += digits[c & 0xF];
+    } else {
+      escaped += c;
+    }
+  }
+  return escaped;
+}
+}  // namespace
+
 CapitalEngine::CapitalEngine() {
   _log.console("\n", _log.style.indentSize, "[ CAPITAL engine ]",
                "starting...\n");
 
   compileShaders();
-  initVulkan();
+  if (!_control.checkpoint.loadPath.empty()) {
+    _checkpoint.open(_control.checkpoint.loadPath);
+  }
+  if (!_control.pattern.path.empty()) {
+    _pattern.open(_control.pattern.path);
+  }
+  if (_control.simulation.headless) {
+    initHeadless();
+  } else {
+    initVulkan();
+  }
+  _checkpoint.close();
+  _pattern.close();
+  if (_mechanics.mainDevice.logical != VK_NULL_HANDLE) {
+    _allocator.logStatistics();
+    _telemetry.logReport();
+  }
 }
 
 CapitalEngine::~CapitalEngine() {
@@ -32,15 +71,78 @@ void CapitalEngine::mainLoop() {
     glfwPollEvents();
 
     _window.setMouse();
-    _control.setPassedHours();
 
     drawFrame();
 
+    static bool hashLifeKeyDown = false;
+    const bool hashLifeKeyPressed =
+        glfwGetKey(_window.window, GLFW_KEY_H) == GLFW_PRESS;
+    if (hashLifeKeyPressed && !hashLifeKeyDown) {
+      fastForwardHashLife();
+    }
+    hashLifeKeyDown = hashLifeKeyPressed;
+
+    static bool ruleKeyDown = false;
+    const bool ruleKeyPressed =
+        glfwGetKey(_window.window, GLFW_KEY_R) == GLFW_PRESS;
+    if (ruleKeyPressed && !ruleKeyDown) {
+      switchRule();
+    }
+    ruleKeyDown = ruleKeyPressed;
+
+    static bool pauseKeyDown = false;
+    const bool pauseKeyPressed =
+        glfwGetKey(_window.window, GLFW_KEY_P) == GLFW_PRESS;
+    if (pauseKeyPressed && !pauseKeyDown) {
+      togglePause();
+    }
+    pauseKeyDown = pauseKeyPressed;
+
+    // [ and ] step through the history by a generation, with shift by a
+    // keyframe interval
+    const uint64_t generation = _control.simulation.generation;
+    const uint64_t scrubStep =
+        glfwGetKey(_window.window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS
+            ? _control.history.keyframeInterval
+            : 1;
+    static bool rewindKeyDown = false;
+    const bool rewindKeyPressed =
+        glfwGetKey(_window.window, GLFW_KEY_LEFT_BRACKET) == GLFW_PRESS;
+    if (rewindKeyPressed && !rewindKeyDown) {
+      restoreGeneration(generation - std::min(scrubStep, generation));
+    }
+    rewindKeyDown = rewindKeyPressed;
+
+    static bool forwardKeyDown = false;
+    const bool forwardKeyPressed =
+        glfwGetKey(_window.window, GLFW_KEY_RIGHT_BRACKET) == GLFW_PRESS;
+    if (forwardKeyPressed && !forwardKeyDown) {
+      restoreGeneration(generation + scrubStep);
+    }
+    forwardKeyDown = forwardKeyPressed;
+
+    static bool checkpointKeyDown = false;
+    const bool checkpointKeyPressed =
+        glfwGetKey(_window.window, GLFW_KEY_C) == GLFW_PRESS;
+    if (checkpointKeyPressed && !checkpointKeyDown) {
+      saveCheckpoint();
+    }
+    checkpointKeyDown = checkpointKeyPressed;
+
+    static bool memoryKeyDown = false;
+    const bool memoryKeyPressed =
+        glfwGetKey(_window.window, GLFW_KEY_M) == GLFW_PRESS;
+    if (memoryKeyPressed && !memoryKeyDown) {
+      _telemetry.logReport();
+    }
+    memoryKeyDown = memoryKeyPressed;
+
     if (glfwGetKey(_window.window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
       break;
     }
   }
   vkDeviceWaitIdle(_mechanics.mainDevice.logical);
+  _recorder.stop();
   _log.console("\n", _log.style.indentSize, "{ Main Loop } ....... terminated");
 }
 
@@ -59,6 +161,7 @@ void CapitalEngine::compileShaders() {
 
 void CapitalEngine::initVulkan() {
   _log.console("{ *** }", "initializing Capital Engine");
+  _window.initWindow();
   _mechanics.createInstance();
   _validation.setupDebugMessenger(_mechanics.instance);
   _mechanics.createSurface();
@@ -73,68 +176,371 @@ void CapitalEngine::initVulkan() {
   _pipelines.createComputePipeline();
 
   _memory.createCommandPool();
+  _uploader.create();
   _pipelines.createColorResources();
   _pipelines.createDepthResources();
   _memory.createFramebuffers();
 
   _memory.createShaderStorageBuffers();
+  _memory.createLandscapeBuffer();
   _memory.createUniformBuffers();
+  // initialize.comp and expand.comp read the grid from the uniform buffers
+  for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+    _memory.updateUniformBuffer(i);
+  }
   _memory.createDescriptorPool();
   _memory.createDescriptorSets();
+  _memory.initializeWorld();
+  if (_pattern.isOpen() &&
+      _control.simulation.backend != Control::Simulation::Backend::cpu) {
+    _memory.expandPattern();
+  }
 
   _memory.createCommandBuffers();
   _memory.createComputeCommandBuffers();
 
   _mechanics.createSyncObjects();
+  _profiler.createQueryPools();
+  if (_control.simulation.prerecorded) {
+    _memory.createPrerecordedCommandBuffers();
+  }
+}
+
+// Instance, compute capable device, storage buffers and compute pipelines
+// only. The CPU backend needs no Vulkan at all.
+void CapitalEngine::initHeadless() {
+  _log.console("{ *** }", "initializing Capital Engine headless");
+  if (_control.simulation.backend == Control::Simulation::Backend::cpu) {
+    _cpuSimulation.load(_world.initializeCells(),
+                        _control.simulation.cpuThreads);
+    return;
+  }
+
+  _mechanics.createInstance();
+  _validation.setupDebugMessenger(_mechanics.instance);
+  _mechanics.pickPhysicalDevice();
+  _mechanics.createLogicalDevice();
+
+  _memory.createDescriptorSetLayout();
+  _pipelines.createComputePipeline();
+  _memory.createCommandPool();
+  _uploader.create();
+
+  _memory.createShaderStorageBuffers();
+  _memory.createLandscapeBuffer();
+  _memory.createUniformBuffers();
+  for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+    _memory.updateUniformBuffer(i);
+  }
+  _memory.createDescriptorPool();
+  _memory.createDescriptorSets();
+  _memory.initializeWorld();
+  if (_pattern.isOpen() &&
+      _control.simulation.backend != Control::Simulation::Backend::cpu) {
+    _memory.expandPattern();
+  }
+
+  _memory.createComputeCommandBuffers();
+  _mechanics.createSyncObjects();
+}
+
+// Steps to the target generation as fast as possible, every submission
+// records up to maxGenerationsPerSubmit generations
+void CapitalEngine::runHeadless() {
+  Control::Simulation& simulation = _control.simulation;
+  _log.console("\n", _log.style.indentSize,
+               "{ Headless } running to generation",
+               simulation.targetGeneration, "\n");
+
+  std::vector<World::Cell> firstCells;
+  const uint64_t firstHours = _control.timer.passedHours;
+  if (simulation.crossChecked) {
+    firstCells = _memory.readShaderStorageBuffer();
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  const uint64_t firstGeneration = simulation.generation;
+  double gpuSeconds = 0.0;
+
+  if (simulation.backend == Control::Simulation::Backend::cpu) {
+    while (simulation.generation < simulation.targetGeneration) {
+      _control.timer.passedHours++;
+      _cpuSimulation.step(_control.timer.passedHours);
+      simulation.generation++;
+    }
+  } else {
+    VulkanMechanics::SynchronizationObjects& syncObjects =
+        _mechanics.syncObjects;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(_mechanics.mainDevice.physical, &properties);
+    VkQueryPool timestamps = VK_NULL_HANDLE;
+    const uint64_t timestampMask = Profiler::getTimestampMask(
+        _mechanics.queues.familyIndices.computeFamily.value());
+    if (properties.limits.timestampComputeAndGraphics && timestampMask != 0) {
+      VkQueryPoolCreateInfo queryPoolInfo{
+          .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+          .queryType = VK_QUERY_TYPE_TIMESTAMP,
+          .queryCount = 2 * MAX_FRAMES_IN_FLIGHT};
+      _mechanics.result(vkCreateQueryPool, _mechanics.mainDevice.logical,
+                        &queryPoolInfo, nullptr, &timestamps);
+    }
+
+    // Once the last submission of the current frame is done, its statistics,
+    // recorded generations and timestamps are read
+    std::vector<bool> submitted(MAX_FRAMES_IN_FLIGHT, false);
+    auto collectFrame = [&]() {
+      const uint32_t frame = syncObjects.currentFrame;
+      _mechanics.waitForFrame(frame);
+      _statistics.collectResults();
+      _recorder.collect();
+      if (timestamps == VK_NULL_HANDLE || !submitted[frame]) {
+        return;
+      }
+      uint64_t ticks[2];
+      vkGetQueryPoolResults(_mechanics.mainDevice.logical, timestamps,
+                            2 * frame, 2, sizeof(ticks), ticks,
+                            sizeof(uint64_t),
+                            VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+      const uint64_t elapsed =
+          ((ticks[1] & timestampMask) - (ticks[0] & timestampMask)) &
+          timestampMask;
+      gpuSeconds += static_cast<double>(elapsed) *
+                    properties.limits.timestampPeriod * 1.0e-9;
+      submitted[frame] = false;
+    };
+
+    // Up to MAX_FRAMES_IN_FLIGHT submissions are queued, the host only
+    // waits before it reuses a frame's command buffer, parameters and
+    // statistics
+    while (simulation.generation < simulation.targetGeneration) {
+      collectFrame();
+      const uint32_t frame = syncObjects.currentFrame;
+      const uint64_t nextGeneration = simulation.generation + 1;
+      VkCommandBuffer commandBuffer = _memory.buffers.command.compute[frame];
+      vkResetCommandBuffer(commandBuffer, 0);
+      _memory.recordHeadlessCommandBuffer(commandBuffer, timestamps,
+                                          2 * frame);
+
+      syncObjects.computeValues[frame] =
+          _mechanics.getTimelineValue(simulation.generation);
+      const uint64_t uploadValue = _uploader.flush();
+      const VkPipelineStageFlags uploadStage =
+          VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+      VkTimelineSemaphoreSubmitInfo timelineInfo{
+          .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+          .waitSemaphoreValueCount = 1,
+          .pWaitSemaphoreValues = &uploadValue,
+          .signalSemaphoreValueCount = 1,
+          .pSignalSemaphoreValues = &syncObjects.computeValues[frame]};
+      VkSubmitInfo submitInfo{
+          .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+          .pNext = &timelineInfo,
+          .waitSemaphoreCount = 1,
+          .pWaitSemaphores = &_uploader.timeline,
+          .pWaitDstStageMask = &uploadStage,
+          .commandBufferCount = 1,
+          .pCommandBuffers = &commandBuffer,
+          .signalSemaphoreCount = 1,
+          .pSignalSemaphores = &syncObjects.simulationTimeline};
+      _mechanics.result(vkQueueSubmit, _mechanics.queues.compute, 1,
+                        &submitInfo, VK_NULL_HANDLE);
+      _statistics.markSubmitted(
+          nextGeneration,
+          static_cast<uint32_t>(simulation.generation + 1 - nextGeneration));
+      submitted[frame] = true;
+      syncObjects.currentFrame = (frame + 1) % MAX_FRAMES_IN_FLIGHT;
+    }
+    for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+      collectFrame();
+      syncObjects.currentFrame =
+          (syncObjects.currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+    }
+
+    if (timestamps != VK_NULL_HANDLE) {
+      vkDestroyQueryPool(_mechanics.mainDevice.logical, timestamps, nullptr);
+    }
+    _recorder.stop();
+  }
+
+  const double seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+          .count();
+  const double generations =
+      static_cast<double>(simulation.generation - firstGeneration);
+  const double cells = static_cast<double>(_control.grid.dimensions[0]) *
+                       _control.grid.dimensions[1] * generations;
+  _log.console("{ Headless }", generations, "generations in", seconds, "s");
+  _log.console(_log.style.charLeader, generations / seconds, "generations/s",
+               cells / seconds / 1.0e6, "M cells/s");
+
+  if (simulation.crossChecked) {
+    crossCheck(firstCells, firstHours);
+  }
+  if (!_control.benchmark.reportPath.empty()) {
+    writeBenchmarkReport(generations, seconds, gpuSeconds);
+  }
+  if (!_control.checkpoint.savePath.empty()) {
+    saveCheckpoint();
+  }
+}
+
+// Steps the CPU backend from the cells the GPU started from through the same
+// hours and compares every cell with the GPU's latest generation
+void CapitalEngine::crossCheck(const std::vector<World::Cell>& firstCells,
+                               uint64_t firstHours) {
+  _cpuSimulation.load(firstCells, _control.simulation.cpuThreads);
+  for (uint64_t hours = firstHours + 1; hours <= _control.timer.passedHours;
+       hours++) {
+    _cpuSimulation.step(hours);
+  }
+
+  const std::vector<World::Cell> gpuCells = _memory.readShaderStorageBuffer();
+  const std::vector<World::Cell>& cpuCells = _cpuSimulation.getCells();
+  size_t mismatches = 0;
+  size_t firstMismatch = 0;
+  for (size_t i = 0; i < gpuCells.size(); i++) {
+    if (gpuCells[i].state != cpuCells[i].state) {
+      firstMismatch = mismatches == 0 ? i : firstMismatch;
+      mismatches++;
+    }
+  }
+
+  const uint32_t width = _control.grid.dimensions[0];
+  if (mismatches > 0) {
+    throw std::runtime_error(
+        "\n!ERROR! CPU and GPU differ in " + std::to_string(mismatches) +
+        " cells at generation " +
+        std::to_string(_control.simulation.generation) + ", first at " +
+        std::to_string(firstMismatch % width) + "," +
+        std::to_string(firstMismatch / width));
+  }
+  _log.console("{ Headless }", "CPU and GPU agree on all", gpuCells.size(),
+               "cells after", _control.timer.passedHours - firstHours,
+               "generations");
+}
+
+// Appends one JSON object per line, CapitalBench collects the lines of all
+// runs of a sweep into its result file
+void CapitalEngine::writeBenchmarkReport(double generations,
+                                         double seconds,
+                                         double gpuSeconds) {
+  static const char* backends[] = {"cells", "packed", "cpu"};
+  const Control::Simulation& simulation = _control.simulation;
+
+  std::string device = "cpu";
+  if (simulation.backend != Control::Simulation::Backend::cpu) {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(_mechanics.mainDevice.physical, &properties);
+    device = properties.deviceName;
+  }
+
+  const double cells = static_cast<double>(_control.grid.dimensions[0]) *
+                       _control.grid.dimensions[1] * generations;
+
+  // Blocks and dedicated memory the Allocator holds in device local heaps
+  VkPhysicalDeviceMemoryProperties memoryProperties;
+  vkGetPhysicalDeviceMemoryProperties(_mechanics.mainDevice.physical,
+                                      &memoryProperties);
+  const Allocator::Statistics statistics = _allocator.getStatistics();
+  VkDeviceSize deviceMemory = 0;
+  for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+    if (memoryProperties.memoryHeaps[i].flags &
+        VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+      deviceMemory += statistics.heapBytes[i];
+    }
+  }
+
+  std::ofstream report(_control.benchmark.reportPath, std::ios::app);
+  if (!report) {
+    throw std::runtime_error("\n!ERROR! failed to open benchmark report: " +
+                             _control.benchmark.reportPath);
+  }
+  report << "{\"backend\": \""
+         << backends[static_cast<int>(simulation.backend)]
+         << "\", \"device\": \"" << escapeJson(device)
+         << "\", \"width\": " << _control.grid.dimensions[0]
+         << ", \"height\": " << _control.grid.dimensions[1]
+         << ", \"alive\": " << _control.grid.totalAliveCells
+         << ", \"seed\": " << _control.grid.seed
+         << ", \"workgroup\": " << _control.compute.localSizeX
+         << ", \"threads\": " << simulation.cpuThreads
+         << ", \"generations\": " << generations
+         << ", \"seconds\": " << seconds
+         << ", \"generationsPerSecond\": " << generations / seconds
+         << ", \"cellsPerSecond\": " << cells / seconds
+         << ", \"gpuSeconds\": " << gpuSeconds
+         << ", \"deviceMemory\": " << deviceMemory << "}\n";
 }
 
 void CapitalEngine::drawFrame() {
-  // Compute submission
-  vkWaitForFences(
-      _mechanics.mainDevice.logical, 1,
-      &_mechanics.syncObjects
-           .computeInFlightFences[_mechanics.syncObjects.currentFrame],
-      VK_TRUE, UINT64_MAX);
-
-  _memory.updateUniformBuffer(_mechanics.syncObjects.currentFrame);
-
-  vkResetFences(
-      _mechanics.mainDevice.logical, 1,
-      &_mechanics.syncObjects
-           .computeInFlightFences[_mechanics.syncObjects.currentFrame]);
-
-  vkResetCommandBuffer(
-      _memory.buffers.command.compute[_mechanics.syncObjects.currentFrame], 0);
-  _memory.recordComputeCommandBuffer(
-      _memory.buffers.command.compute[_mechanics.syncObjects.currentFrame]);
-
-  VkSubmitInfo computeSubmitInfo{
-      .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-      .commandBufferCount = 1,
-      .pCommandBuffers =
-          &_memory.buffers.command.compute[_mechanics.syncObjects.currentFrame],
-      .signalSemaphoreCount = 1,
-      .pSignalSemaphores =
-          &_mechanics.syncObjects
-               .computeFinishedSemaphores[_mechanics.syncObjects.currentFrame]};
-
-  _mechanics.result(
-      vkQueueSubmit, _mechanics.queues.compute, 1, &computeSubmitInfo,
-      _mechanics.syncObjects
-          .computeInFlightFences[_mechanics.syncObjects.currentFrame]);
+  VulkanMechanics::SynchronizationObjects& syncObjects = _mechanics.syncObjects;
+  const uint32_t frame = syncObjects.currentFrame;
+  _mechanics.waitForFrame(frame);
+  _profiler.collectResults();
+  _statistics.collectResults();
+  _recorder.collect();
+
+  _memory.updateUniformBuffer(frame);
+
+  // Compute submission. Without generations due nothing is submitted and the
+  // latest generation in the ring is drawn again, the simulation timeline
+  // signals every generation once only.
+  Control::Simulation& simulation = _control.simulation;
+  const uint32_t generations = _scheduler.scheduleFrame();
+  const bool fastForwarding =
+      simulation.backend == Control::Simulation::Backend::packed &&
+      simulation.targetGeneration > simulation.generation;
+  if (generations > 0 || fastForwarding) {
+    const uint64_t firstGeneration = simulation.generation + 1;
+    VkCommandBuffer computeCommandBuffer =
+        _memory.buffers.command.compute[frame];
+    if (simulation.prerecorded) {
+      computeCommandBuffer = _memory.getPrerecordedCompute(generations);
+      _memory.advanceGenerations(generations);
+    } else {
+      vkResetCommandBuffer(computeCommandBuffer, 0);
+      _memory.recordComputeCommandBuffer(computeCommandBuffer, generations);
+    }
+    syncObjects.computeValues[frame] =
+        _mechanics.getTimelineValue(simulation.generation);
+
+    // Uploads since the last frame, as a fast forward's, are waited for on
+    // the device
+    const uint64_t uploadValue = _uploader.flush();
+    const VkPipelineStageFlags uploadStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    VkTimelineSemaphoreSubmitInfo computeTimelineInfo{
+        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+        .waitSemaphoreValueCount = 1,
+        .pWaitSemaphoreValues = &uploadValue,
+        .signalSemaphoreValueCount = 1,
+        .pSignalSemaphoreValues = &syncObjects.computeValues[frame]};
+
+    VkSubmitInfo computeSubmitInfo{
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext = &computeTimelineInfo,
+        .waitSemaphoreCount = 1,
+        .pWaitSemaphores = &_uploader.timeline,
+        .pWaitDstStageMask = &uploadStage,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &computeCommandBuffer,
+        .signalSemaphoreCount = 1,
+        .pSignalSemaphores = &syncObjects.simulationTimeline};
+
+    _mechanics.result(vkQueueSubmit, _mechanics.queues.compute, 1,
+                      &computeSubmitInfo, VK_NULL_HANDLE);
+    _profiler.markSubmitted(Profiler::Pass::compute);
+    _statistics.markSubmitted(
+        firstGeneration,
+        static_cast<uint32_t>(simulation.generation + 1 - firstGeneration));
+  }
 
   // Graphics submission
-  vkWaitForFences(_mechanics.mainDevice.logical, 1,
-                  &_mechanics.syncObjects
-                       .inFlightFences[_mechanics.syncObjects.currentFrame],
-                  VK_TRUE, UINT64_MAX);
-
+  auto presentStart = std::chrono::steady_clock::now();
   uint32_t imageIndex;
   VkResult result = vkAcquireNextImageKHR(
       _mechanics.mainDevice.logical, _mechanics.swapChain.swapChain, UINT64_MAX,
-      _mechanics.syncObjects
-          .imageAvailableSemaphores[_mechanics.syncObjects.currentFrame],
-      VK_NULL_HANDLE, &imageIndex);
+      syncObjects.imageAvailableSemaphores[frame], VK_NULL_HANDLE, &imageIndex);
 
   if (result == VK_ERROR_OUT_OF_DATE_KHR) {
     _mechanics.recreateSwapChain();
@@ -142,58 +548,75 @@ void CapitalEngine::drawFrame() {
   } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
     throw std::runtime_error("\n!ERROR! failed to acquire swap chain image!");
   }
+  double presentMilliseconds =
+      std::chrono::duration<double, std::milli>(
+          std::chrono::steady_clock::now() - presentStart)
+          .count();
+
+  VkCommandBuffer graphicCommandBuffer = _memory.buffers.command.graphic[frame];
+  if (simulation.prerecorded) {
+    graphicCommandBuffer = _memory.getPrerecordedGraphic(imageIndex);
+  } else {
+    vkResetCommandBuffer(graphicCommandBuffer, 0);
+    _memory.recordCommandBuffer(graphicCommandBuffer, imageIndex,
+                                _scheduler.getLatestSlot());
+  }
 
-  vkResetFences(_mechanics.mainDevice.logical, 1,
-                &_mechanics.syncObjects
-                     .inFlightFences[_mechanics.syncObjects.currentFrame]);
-
-  vkResetCommandBuffer(
-      _memory.buffers.command.graphic[_mechanics.syncObjects.currentFrame], 0);
-
-  _memory.recordCommandBuffer(
-      _memory.buffers.command.graphic[_mechanics.syncObjects.currentFrame],
-      imageIndex);
-
+  // The drawn generation and the uploads are waited for at vertex input. The
+  // values of the binary swap chain semaphores are ignored.
   std::vector<VkSemaphore> waitSemaphores{
-      _mechanics.syncObjects
-          .computeFinishedSemaphores[_mechanics.syncObjects.currentFrame],
-      _mechanics.syncObjects
-          .imageAvailableSemaphores[_mechanics.syncObjects.currentFrame]};
+      syncObjects.simulationTimeline, _uploader.timeline,
+      syncObjects.imageAvailableSemaphores[frame]};
+  std::vector<uint64_t> waitValues{
+      _mechanics.getTimelineValue(simulation.generation), _uploader.flush(),
+      0};
   std::vector<VkPipelineStageFlags> waitStages{
-      VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+      VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
       VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
 
+  syncObjects.frameValues[frame] = ++syncObjects.frameValue;
+  std::vector<VkSemaphore> signalSemaphores{
+      syncObjects.renderFinishedSemaphores[frame], syncObjects.frameTimeline};
+  std::vector<uint64_t> signalValues{0, syncObjects.frameValues[frame]};
+
+  VkTimelineSemaphoreSubmitInfo graphicsTimelineInfo{
+      .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+      .waitSemaphoreValueCount = static_cast<uint32_t>(waitValues.size()),
+      .pWaitSemaphoreValues = waitValues.data(),
+      .signalSemaphoreValueCount = static_cast<uint32_t>(signalValues.size()),
+      .pSignalSemaphoreValues = signalValues.data()};
+
   VkSubmitInfo graphicsSubmitInfo{
       .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+      .pNext = &graphicsTimelineInfo,
       .waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size()),
       .pWaitSemaphores = waitSemaphores.data(),
       .pWaitDstStageMask = waitStages.data(),
       .commandBufferCount = 1,
-      .pCommandBuffers =
-          &_memory.buffers.command.graphic[_mechanics.syncObjects.currentFrame],
-      .signalSemaphoreCount = 1,
-      .pSignalSemaphores =
-          &_mechanics.syncObjects
-               .renderFinishedSemaphores[_mechanics.syncObjects.currentFrame]};
+      .pCommandBuffers = &graphicCommandBuffer,
+      .signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size()),
+      .pSignalSemaphores = signalSemaphores.data()};
 
   _mechanics.result(vkQueueSubmit, _mechanics.queues.graphics, 1,
-                    &graphicsSubmitInfo,
-                    _mechanics.syncObjects
-                        .inFlightFences[_mechanics.syncObjects.currentFrame]);
+                    &graphicsSubmitInfo, VK_NULL_HANDLE);
+  _profiler.markSubmitted(Profiler::Pass::render);
 
   std::vector<VkSwapchainKHR> swapChains{_mechanics.swapChain.swapChain};
 
   VkPresentInfoKHR presentInfo{
       .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
       .waitSemaphoreCount = 1,
-      .pWaitSemaphores =
-          &_mechanics.syncObjects
-               .renderFinishedSemaphores[_mechanics.syncObjects.currentFrame],
+      .pWaitSemaphores = &syncObjects.renderFinishedSemaphores[frame],
       .swapchainCount = 1,
       .pSwapchains = swapChains.data(),
       .pImageIndices = &imageIndex};
 
+  presentStart = std::chrono::steady_clock::now();
   result = vkQueuePresentKHR(_mechanics.queues.present, &presentInfo);
+  presentMilliseconds += std::chrono::duration<double, std::milli>(
+                             std::chrono::steady_clock::now() - presentStart)
+                             .count();
+  _profiler.addHostTime(Profiler::Pass::present, presentMilliseconds);
 
   if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR ||
       _window.framebufferResized) {
@@ -203,11 +626,101 @@ void CapitalEngine::drawFrame() {
     throw std::runtime_error("\n!ERROR! failed to present swap chain image!");
   }
 
-  _mechanics.syncObjects.currentFrame =
-      (_mechanics.syncObjects.currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+  syncObjects.currentFrame = (frame + 1) % MAX_FRAMES_IN_FLIGHT;
+  _profiler.endFrame();
+}
+
+// The pipelines of every rule exist already, frames recorded from now on
+// bind the next rule's pipelines. Prerecorded command buffers are recorded
+// again once none of them is pending.
+void CapitalEngine::switchRule() {
+  Control::Rules& rules = _control.rules;
+  rules.current = (rules.current + 1) % rules.available.size();
+  _pipelines.selectRule(_control.getRule());
+  if (_control.simulation.prerecorded) {
+    vkDeviceWaitIdle(_mechanics.mainDevice.logical);
+    _memory.createPrerecordedCommandBuffers();
+  }
+  _log.console("{ RUL }", "switched to", _control.getRule().name);
+}
+
+void CapitalEngine::togglePause() {
+  _control.timer.paused = !_control.timer.paused;
+  _log.console("{ TIM }", _control.timer.paused ? "paused" : "resumed",
+               "at generation", _control.simulation.generation);
+}
+
+// Pauses on the generation from the history, or on the keyframe before it
+// once it is no longer among the last history.length generations. Resuming
+// computes the following generations again from there.
+void CapitalEngine::restoreGeneration(uint64_t generation) {
+  if (!_history.isEnabled()) {
+    _log.console("{ HIS }", "rewinding needs a history, see --history");
+    return;
+  }
+  const std::optional<History::Snapshot> snapshot = _history.find(generation);
+  if (!snapshot) {
+    _log.console("{ HIS }", "generation", generation, "is not in the history");
+    return;
+  }
+
+  _mechanics.orderUploadsAfterSubmissions();
+  _memory.restoreSnapshot(*snapshot);
+
+  _mechanics.continueTimelineAt(snapshot->generation);
+  _control.simulation.generation = snapshot->generation;
+  _control.timer.passedHours = snapshot->passedHours;
+  _control.timer.paused = true;
+  _log.console("{ HIS }", "restored generation", snapshot->generation);
+}
+
+// Reads the current grid back, jumps it forward on the CPU and hands the
+// result to both packed generations for rendering
+void CapitalEngine::fastForwardHashLife() {
+  Control::Simulation& simulation = _control.simulation;
+  if (simulation.backend != Control::Simulation::Backend::packed) {
+    _log.console("{ HLF }", "fast forward needs the packed backend");
+    return;
+  }
+  const uint32_t width = _control.grid.dimensions[0];
+  const uint32_t height = _control.grid.dimensions[1];
+
+  // HashLife runs on the host, so the readback is the one wait. The result
+  // goes back through the uploader once frames still drawing the ring are
+  // done, and later submissions wait for it on the device.
+  _mechanics.waitForGeneration(simulation.generation);
+  _hashLife.load(_memory.readShaderStorageBuffer(), width, height);
+  _hashLife.step(simulation.hashLifeJump);
+  _mechanics.orderUploadsAfterSubmissions();
+  _memory.uploadCells(_hashLife.extract(width, height));
+
+  simulation.generation += uint64_t{1} << simulation.hashLifeJump;
+  _mechanics.signalGeneration(simulation.generation);
+  _log.console("{ HLF }", "jumped to generation", simulation.generation);
+  _hashLife.logStatistics();
+}
+
+// The CPU backend saves its host grid, the others read the latest generation
+// in the ring back
+void CapitalEngine::saveCheckpoint() {
+  const std::string& path = _control.checkpoint.savePath;
+  if (path.empty()) {
+    _log.console("{ CKP }", "saving needs a file, see --save");
+    return;
+  }
+  if (_control.simulation.backend == Control::Simulation::Backend::cpu) {
+    _checkpoint.save(path, _cpuSimulation.getCells().data());
+    return;
+  }
+  vkDeviceWaitIdle(_mechanics.mainDevice.logical);
+  _memory.saveCheckpoint(path);
 }
 
 void Global::cleanup() {
+  if (_mechanics.mainDevice.logical == VK_NULL_HANDLE) {
+    return;
+  }
+  _recorder.stop();
   _mechanics.cleanupSwapChain();
 
   vkDestroyPipeline(_mechanics.mainDevice.logical, _pipelines.graphics.pipeline,
@@ -215,8 +728,30 @@ void Global::cleanup() {
   vkDestroyPipelineLayout(_mechanics.mainDevice.logical,
                           _pipelines.graphics.pipelineLayout, nullptr);
 
-  vkDestroyPipeline(_mechanics.mainDevice.logical, _pipelines.compute.pipeline,
-                    nullptr);
+  for (const auto& [rule, pipelines] : _pipelines.compute.rulePipelines) {
+    vkDestroyPipeline(_mechanics.mainDevice.logical, pipelines.pipeline,
+                      nullptr);
+    vkDestroyPipeline(_mechanics.mainDevice.logical, pipelines.packedPipeline,
+                      nullptr);
+    vkDestroyPipeline(_mechanics.mainDevice.logical,
+                      pipelines.columnsPipeline, nullptr);
+    vkDestroyPipeline(_mechanics.mainDevice.logical, pipelines.rowsPipeline,
+                      nullptr);
+  }
+  vkDestroyPipelineCache(_mechanics.mainDevice.logical,
+                         _pipelines.compute.cache, nullptr);
+  vkDestroyPipeline(_mechanics.mainDevice.logical,
+                    _pipelines.compute.expandPipeline, nullptr);
+  vkDestroyPipeline(_mechanics.mainDevice.logical,
+                    _pipelines.compute.activityPipeline, nullptr);
+  vkDestroyPipeline(_mechanics.mainDevice.logical,
+                    _pipelines.compute.snapshotPipeline, nullptr);
+  vkDestroyPipeline(_mechanics.mainDevice.logical,
+                    _pipelines.compute.restorePipeline, nullptr);
+  vkDestroyPipeline(_mechanics.mainDevice.logical,
+                    _pipelines.compute.deltaPipeline, nullptr);
+  vkDestroyPipeline(_mechanics.mainDevice.logical,
+                    _pipelines.compute.initializePipeline, nullptr);
   vkDestroyPipelineLayout(_mechanics.mainDevice.logical,
                           _pipelines.compute.pipelineLayout, nullptr);
 
@@ -227,8 +762,10 @@ void Global::cleanup() {
     vkDestroyBuffer(_mechanics.mainDevice.logical,
 
                     _memory.buffers.uniforms[i], nullptr);
-    vkFreeMemory(_mechanics.mainDevice.logical,
-                 _memory.buffers.uniformsMemory[i], nullptr);
+    _allocator.free(_memory.buffers.uniformsMemory[i]);
+    vkDestroyBuffer(_mechanics.mainDevice.logical,
+                    _memory.buffers.parameters[i], nullptr);
+    _allocator.free(_memory.buffers.parametersMemory[i]);
   }
 
   vkDestroyDescriptorPool(_mechanics.mainDevice.logical,
@@ -237,13 +774,55 @@ void Global::cleanup() {
   vkDestroyDescriptorSetLayout(_mechanics.mainDevice.logical,
                                _memory.descriptor.setLayout, nullptr);
 
-  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+  for (size_t i = 0; i < _memory.buffers.shaderStorage.size(); i++) {
     vkDestroyBuffer(_mechanics.mainDevice.logical,
                     _memory.buffers.shaderStorage[i], nullptr);
-    vkFreeMemory(_mechanics.mainDevice.logical,
-                 _memory.buffers.shaderStorageMemory[i], nullptr);
+    _allocator.free(_memory.buffers.shaderStorageMemory[i]);
   }
 
+  vkDestroyBuffer(_mechanics.mainDevice.logical, _memory.buffers.landscape,
+                  nullptr);
+  _allocator.free(_memory.buffers.landscapeMemory);
+
+  vkDestroyBuffer(_mechanics.mainDevice.logical, _memory.buffers.packed,
+                  nullptr);
+  _allocator.free(_memory.buffers.packedMemory);
+  vkDestroyBuffer(_mechanics.mainDevice.logical, _memory.buffers.activity,
+                  nullptr);
+  _allocator.free(_memory.buffers.activityMemory);
+  vkDestroyBuffer(_mechanics.mainDevice.logical,
+                  _memory.buffers.neighbourSums, nullptr);
+  _allocator.free(_memory.buffers.neighbourSumsMemory);
+  vkDestroyBuffer(_mechanics.mainDevice.logical, _memory.buffers.history,
+                  nullptr);
+  _allocator.free(_memory.buffers.historyMemory);
+  vkDestroyBuffer(_mechanics.mainDevice.logical, _memory.buffers.recording,
+                  nullptr);
+  _allocator.free(_memory.buffers.recordingMemory);
+  vkDestroyBuffer(_mechanics.mainDevice.logical,
+                  _memory.buffers.recordingReadback, nullptr);
+  _allocator.free(_memory.buffers.recordingReadbackMemory);
+
+  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+    vkDestroyBuffer(_mechanics.mainDevice.logical,
+                    _memory.buffers.statistics[i], nullptr);
+    _allocator.free(_memory.buffers.statisticsMemory[i]);
+  }
+  for (size_t i = 0; i < _memory.buffers.statisticsReadback.size(); i++) {
+    vkDestroyBuffer(_mechanics.mainDevice.logical,
+                    _memory.buffers.statisticsReadback[i], nullptr);
+    _allocator.free(_memory.buffers.statisticsReadbackMemory[i]);
+  }
+
+  for (size_t i = 0; i < _memory.buffers.cpuStaging.size(); i++) {
+    vkDestroyBuffer(_mechanics.mainDevice.logical,
+                    _memory.buffers.cpuStaging[i], nullptr);
+    _allocator.free(_memory.buffers.cpuStagingMemory[i]);
+  }
+
+  // Its last batch may wait for the timelines
+  _uploader.destroy();
+
   for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
     vkDestroySemaphore(_mechanics.mainDevice.logical,
                        _mechanics.syncObjects.renderFinishedSemaphores[i],
@@ -251,19 +830,21 @@ void Global::cleanup() {
     vkDestroySemaphore(_mechanics.mainDevice.logical,
                        _mechanics.syncObjects.imageAvailableSemaphores[i],
                        nullptr);
-    vkDestroySemaphore(_mechanics.mainDevice.logical,
-                       _mechanics.syncObjects.computeFinishedSemaphores[i],
-                       nullptr);
-    vkDestroyFence(_mechanics.mainDevice.logical,
-                   _mechanics.syncObjects.inFlightFences[i], nullptr);
-    vkDestroyFence(_mechanics.mainDevice.logical,
-                   _mechanics.syncObjects.computeInFlightFences[i], nullptr);
   }
+  vkDestroySemaphore(_mechanics.mainDevice.logical,
+                     _mechanics.syncObjects.simulationTimeline, nullptr);
+  vkDestroySemaphore(_mechanics.mainDevice.logical,
+                     _mechanics.syncObjects.frameTimeline, nullptr);
+
+  _profiler.destroyQueryPools();
 
   vkDestroyCommandPool(_mechanics.mainDevice.logical,
                        _memory.buffers.command.pool, nullptr);
+  vkDestroyCommandPool(_mechanics.mainDevice.logical,
+                       _memory.buffers.command.computePool, nullptr);
 
-  vkDestroyDevice(_mechanics.mainDevice.logical, nullptr);
+  _allocator.destroy();
+  vkDestroyDevice(_mechanics.mainDevice.logical, _telemetry.getCallbacks());
 
   if (_validation.enableValidationLayers) {
     _validation.DestroyDebugUtilsMessengerEXT(
@@ -271,9 +852,5 @@ void Global::cleanup() {
   }
 
   vkDestroySurfaceKHR(_mechanics.instance, _mechanics.surface, nullptr);
-  vkDestroyInstance(_mechanics.instance, nullptr);
-
-  glfwDestroyWindow(_window.window);
-
-  glfwTerminate();
+  vkDestroyInstance(_mechanics.instance, _telemetry.getCallbacks());
 }
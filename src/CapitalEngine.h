@@ -1,9 +1,21 @@
 #pragma once
+#include "Allocator.h"
+#include "Checkpoint.h"
 #include "Control.h"
+#include "CpuSimulation.h"
 #include "Debug.h"
+#include "HashLife.h"
+#include "History.h"
 #include "Mechanics.h"
 #include "Memory.h"
+#include "MemoryTelemetry.h"
+#include "Pattern.h"
 #include "Pipelines.h"
+#include "Profiler.h"
+#include "Recorder.h"
+#include "Scheduler.h"
+#include "Statistics.h"
+#include "Uploader.h"
 #include "Window.h"
 #include "World.h"
 
@@ -13,11 +25,23 @@ class CapitalEngine {
   ~CapitalEngine();
 
   void mainLoop();
+  void runHeadless();
 
  private:
   void compileShaders();
   void initVulkan();
+  void initHeadless();
   void drawFrame();
+  void switchRule();
+  void togglePause();
+  void restoreGeneration(uint64_t generation);
+  void fastForwardHashLife();
+  void saveCheckpoint();
+  void crossCheck(const std::vector<World::Cell>& firstCells,
+                  uint64_t firstHours);
+  void writeBenchmarkReport(double generations,
+                            double seconds,
+                            double gpuSeconds);
 };
 
 class Global {
@@ -34,10 +58,22 @@ class Global {
     ValidationLayers validation;
     Control control;
     VulkanMechanics mechanics;
+    Allocator allocator;
+    MemoryTelemetry telemetry;
     Pipelines pipelines;
     Memory memory;
+    Uploader uploader;
+    Profiler profiler;
+    Scheduler scheduler;
+    History history;
+    Recorder recorder;
+    Statistics statistics;
     Window mainWindow;
     World world;
+    HashLife hashLife;
+    Checkpoint checkpoint;
+    Pattern pattern;
+    CpuSimulation cpuSimulation;
   };
   inline static Objects obj;
 
@@ -49,7 +85,19 @@ inline static auto& _log = Global::obj.logging;
 inline static auto& _validation = Global::obj.validation;
 inline static auto& _window = Global::obj.mainWindow;
 inline static auto& _mechanics = Global::obj.mechanics;
+inline static auto& _allocator = Global::obj.allocator;
+inline static auto& _telemetry = Global::obj.telemetry;
 inline static auto& _pipelines = Global::obj.pipelines;
 inline static auto& _memory = Global::obj.memory;
+inline static auto& _uploader = Global::obj.uploader;
+inline static auto& _profiler = Global::obj.profiler;
+inline static auto& _scheduler = Global::obj.scheduler;
+inline static auto& _history = Global::obj.history;
+inline static auto& _recorder = Global::obj.recorder;
+inline static auto& _statistics = Global::obj.statistics;
 inline static auto& _control = Global::obj.control;
 inline static auto& _world = Global::obj.world;
+inline static auto& _hashLife = Global::obj.hashLife;
+inline static auto& _checkpoint = Global::obj.checkpoint;
+inline static auto& _pattern = Global::obj.pattern;
+inline static auto& _cpuSimulation = Global::obj.cpuSimulation;
@@ -0,0 +1,298 @@
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "CapitalEngine.h"
+#include "Checkpoint.h"
+
+namespace {
+// A run length encoded chunk is a sequence of packets: a control word with
+// the top bit set repeats the following word (control & ~runFlag) times,
+// otherwise control literal words follow it
+constexpr uint32_t runFlag{0x80000000u};
+// Shorter runs stay literals, a run packet costs two words
+constexpr size_t minimumRun{3};
+}  // namespace
+
+static_assert(sizeof(Checkpoint::Header) == 112);
+static_assert(sizeof(Checkpoint::Chunk) == 24);
+
+Checkpoint::Checkpoint() : header{}, chunks{nullptr} {
+  _log.console("{ CKP }", "constructing Checkpoint");
+}
+
+Checkpoint::~Checkpoint() {
+  _log.console("{ CKP }", "destructing Checkpoint");
+}
+
+// Maps the file and takes over its grid dimensions, rule, generation and hour,
+// before any buffer is sized from them. The mapping stays open until the
+// cells were loaded.
+void Checkpoint::open(const std::string& path) {
+  _log.console("{ CKP }", "opening checkpoint", path);
+  file.openForReading(path);
+
+  if (file.size < sizeof(Header)) {
+    throw std::runtime_error("\n!ERROR! Not a checkpoint: " + path);
+  }
+  std::memcpy(&header, file.data, sizeof(Header));
+  if (header.magic != magic) {
+    throw std::runtime_error("\n!ERROR! Not a checkpoint: " + path);
+  }
+  if (header.version != version) {
+    throw std::runtime_error("\n!ERROR! Unsupported checkpoint version " +
+                             std::to_string(header.version));
+  }
+  if (header.width == 0 || header.height == 0 || header.width > UINT16_MAX ||
+      header.height > UINT16_MAX || header.chunkRows == 0 ||
+      header.chunkCount !=
+          (header.height + header.chunkRows - 1) / header.chunkRows ||
+      header.rule.back() != '\0') {
+    throw std::runtime_error("\n!ERROR! Corrupt checkpoint header: " + path);
+  }
+
+  const uint64_t tableEnd =
+      sizeof(Header) + uint64_t{header.chunkCount} * sizeof(Chunk);
+  if (tableEnd > file.size) {
+    throw std::runtime_error("\n!ERROR! Truncated checkpoint: " + path);
+  }
+  chunks = reinterpret_cast<const Chunk*>(file.data + sizeof(Header));
+  for (uint32_t i = 0; i < header.chunkCount; i++) {
+    const Chunk& chunk = chunks[i];
+    if (chunk.offset < tableEnd || chunk.offset > file.size ||
+        chunk.size > file.size - chunk.offset || chunk.offset % 4 != 0 ||
+        chunk.size % 4 != 0) {
+      throw std::runtime_error("\n!ERROR! Truncated checkpoint: " + path);
+    }
+  }
+
+  _control.grid.dimensions = {static_cast<uint_fast16_t>(header.width),
+                              static_cast<uint_fast16_t>(header.height)};
+  _control.simulation.generation = header.generation;
+  _control.timer.passedHours = header.passedHours;
+
+  const Control::Rule rule = Control::parseRule(header.rule.data());
+  Control::Rules& rules = _control.rules;
+  const auto known =
+      std::find_if(rules.available.begin(), rules.available.end(),
+                   [&](const Control::Rule& r) { return r.name == rule.name; });
+  rules.current = static_cast<size_t>(known - rules.available.begin());
+  if (known == rules.available.end()) {
+    rules.available.push_back(rule);
+  }
+  _control.checkRules();
+
+  _log.console(_log.style.charLeader, "generation", header.generation, "of",
+               header.width, "*", header.height, "cells,", rule.name);
+}
+
+bool Checkpoint::isOpen() const {
+  return file.data != nullptr;
+}
+
+void Checkpoint::close() {
+  file.close(file.size);
+  chunks = nullptr;
+}
+
+uint32_t Checkpoint::getChunkCount() const {
+  return header.chunkCount;
+}
+
+// Writes the chunk's rows to cells, which point at its first row
+void Checkpoint::decodeChunk(uint32_t chunk, World::Cell* cells) const {
+  const uint32_t width = header.width;
+  const uint32_t wordsPerRow = getWordsPerRow();
+  const size_t wordCount = static_cast<size_t>(wordsPerRow) *
+                           getChunkHeight(chunk);
+  const Chunk& entry = chunks[chunk];
+  const uint32_t* in =
+      reinterpret_cast<const uint32_t*>(file.data + entry.offset);
+
+  thread_local std::vector<uint32_t> decoded;
+  const uint32_t* words = in;
+  if (entry.encoding == Encoding::runLength) {
+    decodeRunLength(in, entry.size / 4, wordCount, decoded);
+    words = decoded.data();
+  } else if (entry.encoding != Encoding::raw ||
+             entry.size != wordCount * sizeof(uint32_t)) {
+    throw std::runtime_error("\n!ERROR! Corrupt checkpoint chunk " +
+                             std::to_string(chunk));
+  }
+
+  for (uint32_t y = 0; y < getChunkHeight(chunk); y++) {
+    const uint32_t* row = words + static_cast<size_t>(y) * wordsPerRow;
+    World::Cell* out = cells + static_cast<size_t>(y) * width;
+    for (uint32_t x = 0; x < width; x++) {
+      out[x].state = getState((row[x / 16] >> (2 * (x % 16))) & 0x3u,
+                              header.passedHours);
+    }
+  }
+}
+
+// For the backends that keep a host copy of the grid anyway
+std::vector<World::Cell> Checkpoint::readCells() const {
+  std::vector<World::Cell> cells(static_cast<size_t>(header.width) *
+                                 header.height);
+  for (uint32_t chunk = 0; chunk < header.chunkCount; chunk++) {
+    decodeChunk(chunk, cells.data() + static_cast<size_t>(chunk) * chunkRows *
+                                          header.width);
+  }
+  return cells;
+}
+
+// The file is created at the size of raw chunks and shrunk to what the
+// encoded ones take, every chunk is packed and encoded straight into it
+void Checkpoint::save(const std::string& path, const World::Cell* cells) const {
+  const uint32_t width = static_cast<uint32_t>(_control.grid.dimensions[0]);
+  const uint32_t height = static_cast<uint32_t>(_control.grid.dimensions[1]);
+  const uint32_t wordsPerRow = (width + 15) / 16;
+  const uint32_t chunkCount = (height + chunkRows - 1) / chunkRows;
+  const uint64_t tableEnd =
+      sizeof(Header) + uint64_t{chunkCount} * sizeof(Chunk);
+
+  Header out{.magic = magic,
+             .version = version,
+             .chunkRows = chunkRows,
+             .width = width,
+             .height = height,
+             .generation = _control.simulation.generation,
+             .passedHours = _control.timer.passedHours,
+             .rule = {},
+             .chunkCount = chunkCount,
+             .reserved = 0};
+  const std::string& rule = _control.getRule().name;
+  if (rule.size() >= out.rule.size()) {
+    throw std::runtime_error("\n!ERROR! Rulestring too long to checkpoint: " +
+                             rule);
+  }
+  std::copy(rule.begin(), rule.end(), out.rule.begin());
+
+  MappedFile output;
+  output.create(path, tableEnd + sizeof(uint32_t) * wordsPerRow * height);
+  std::memcpy(output.data, &out, sizeof(Header));
+  Chunk* table = reinterpret_cast<Chunk*>(output.data + sizeof(Header));
+
+  uint64_t offset = tableEnd;
+  std::vector<uint32_t> words;
+  for (uint32_t chunk = 0; chunk < chunkCount; chunk++) {
+    const uint32_t firstRow = chunk * chunkRows;
+    const uint32_t rows = std::min(chunkRows, height - firstRow);
+    words.assign(static_cast<size_t>(wordsPerRow) * rows, 0);
+    for (uint32_t y = 0; y < rows; y++) {
+      const World::Cell* row =
+          cells + static_cast<size_t>(firstRow + y) * width;
+      uint32_t* packed = words.data() + static_cast<size_t>(y) * wordsPerRow;
+      for (uint32_t x = 0; x < width; x++) {
+        packed[x / 16] |= (row[x].state & 0x3u) << (2 * (x % 16));
+      }
+    }
+
+    uint32_t* data = reinterpret_cast<uint32_t*>(output.data + offset);
+    Encoding encoding = Encoding::runLength;
+    size_t size = encodeRunLength(words, data, words.size());
+    if (size == 0) {
+      encoding = Encoding::raw;
+      size = words.size();
+      std::memcpy(data, words.data(), sizeof(uint32_t) * size);
+    }
+    table[chunk] = {.offset = offset,
+                    .size = sizeof(uint32_t) * size,
+                    .encoding = encoding,
+                    .reserved = 0};
+    offset += sizeof(uint32_t) * size;
+  }
+  output.close(offset);
+
+  _log.console("{ CKP }", "saved generation", out.generation, "to", path);
+  _log.console(_log.style.charLeader, offset, "bytes,", chunkCount, "chunks");
+}
+
+uint32_t Checkpoint::getWordsPerRow() const {
+  return (header.width + 15) / 16;
+}
+
+uint32_t Checkpoint::getChunkHeight(uint32_t chunk) const {
+  return std::min(header.chunkRows, header.height - chunk * header.chunkRows);
+}
+
+// Same as restore.comp, cells of generation 0 carry no cycle or hour yet
+uint32_t Checkpoint::getState(uint32_t stateBits, uint64_t passedHours) {
+  if (passedHours == 0) {
+    return stateBits;
+  }
+  const uint32_t cycle = static_cast<uint32_t>(passedHours % 24) + 1;
+  const uint32_t hour = static_cast<uint32_t>(passedHours) & 0xFFFFFFu;
+  return stateBits | (cycle << 2) | (hour << 8);
+}
+
+// Number of words written, or 0 once the encoding would not be smaller than
+// capacity words
+size_t Checkpoint::encodeRunLength(const std::vector<uint32_t>& words,
+                                   uint32_t* out,
+                                   size_t capacity) {
+  size_t written = 0;
+  size_t literals = 0;
+  size_t i = 0;
+  while (true) {
+    size_t run = 0;
+    if (i < words.size()) {
+      run = 1;
+      while (i + run < words.size() && words[i + run] == words[i] &&
+             run < ~runFlag) {
+        run++;
+      }
+    }
+    if (run != 0 && run < minimumRun) {
+      i += run;
+      continue;
+    }
+
+    const size_t count = i - literals;
+    if (count > 0) {
+      if (written + 1 + count >= capacity) {
+        return 0;
+      }
+      out[written++] = static_cast<uint32_t>(count);
+      std::memcpy(out + written, words.data() + literals,
+                  sizeof(uint32_t) * count);
+      written += count;
+    }
+    if (run == 0) {
+      return written;
+    }
+    if (written + 2 >= capacity) {
+      return 0;
+    }
+    out[written++] = runFlag | static_cast<uint32_t>(run);
+    out[written++] = words[i];
+    i += run;
+    literals = i;
+  }
+}
+
+void Checkpoint::decodeRunLength(const uint32_t* in,
+                                 size_t size,
+                                 size_t wordCount,
+                                 std::vector<uint32_t>& words) {
+  words.clear();
+  words.reserve(wordCount);
+  size_t i = 0;
+  while (i < size) {
+    const uint32_t control = in[i++];
+    const size_t count = control & ~runFlag;
+    const bool repeated = (control & runFlag) != 0;
+    if (count > wordCount - words.size() || size - i < (repeated ? 1 : count)) {
+      throw std::runtime_error("\n!ERROR! Corrupt run length encoded chunk");
+    }
+    if (repeated) {
+      words.insert(words.end(), count, in[i++]);
+    } else {
+      words.insert(words.end(), in + i, in + i + count);
+      i += count;
+    }
+  }
+  if (words.size() != wordCount) {
+    throw std::runtime_error("\n!ERROR! Corrupt run length encoded chunk");
+  }
+}
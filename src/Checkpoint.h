@@ -0,0 +1,76 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+#include "World.h"
+
+// Versioned grid checkpoints. A Header and a table of chunkCount Chunks are
+// followed by the chunks, chunkRows rows each, in the two bits per cell layout
+// of a history snapshot, see snapshot.comp. A chunk is stored raw or run length
+// encoded, whichever is smaller. Fields are little endian. Files are read and
+// written through memory mappings, loading decodes chunk by chunk straight
+// into the caller's memory, usually a mapped staging buffer.
+class Checkpoint {
+ public:
+  Checkpoint();
+  ~Checkpoint();
+
+  inline static const std::array<char, 8> magic{'C', 'A', 'P', 'I',
+                                                'T', 'A', 'L', '\0'};
+  inline static const uint32_t version{1};
+  inline static const uint32_t chunkRows{256};
+
+  struct Header {
+    std::array<char, 8> magic;
+    uint32_t version;
+    uint32_t chunkRows;
+    uint32_t width;
+    uint32_t height;
+    uint64_t generation;
+    uint64_t passedHours;
+    // Canonical rulestring, see Control::parseRule
+    std::array<char, 64> rule;
+    uint32_t chunkCount;
+    uint32_t reserved;
+  };
+
+  enum class Encoding : uint32_t { raw, runLength };
+
+  // Offset from the start of the file and size in bytes
+  struct Chunk {
+    uint64_t offset;
+    uint64_t size;
+    Encoding encoding;
+    uint32_t reserved;
+  };
+
+ public:
+  void open(const std::string& path);
+  bool isOpen() const;
+  void close();
+  uint32_t getChunkCount() const;
+  void decodeChunk(uint32_t chunk, World::Cell* cells) const;
+  std::vector<World::Cell> readCells() const;
+  void save(const std::string& path, const World::Cell* cells) const;
+  // Also encode the frames of a Recorder
+  static size_t encodeRunLength(const std::vector<uint32_t>& words,
+                                uint32_t* out,
+                                size_t capacity);
+  static void decodeRunLength(const uint32_t* in,
+                              size_t size,
+                              size_t wordCount,
+                              std::vector<uint32_t>& words);
+
+ private:
+  MappedFile file;
+  Header header;
+  const Chunk* chunks;
+
+  uint32_t getWordsPerRow() const;
+  uint32_t getChunkHeight(uint32_t chunk) const;
+  static uint32_t getState(uint32_t stateBits, uint64_t passedHours);
+};
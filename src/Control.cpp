@@ -1,12 +1,48 @@
-#include <chrono>
+#include <algorithm>
+#include <cctype>
 #include <numbers>
 #include <random>
+#include <stdexcept>
+#include <string>
 #include <unordered_set>
+#include <vector>
 
 #include "CapitalEngine.h"
 #include "Control.h"
 #include "World.h"
 
+namespace {
+// Larger than Life rules are comma separated too: the C, M, S, B and N
+// fields after R<r> belong to the same rule, which N ends
+std::vector<std::string> splitRules(const std::string& value) {
+  std::vector<std::string> rulestrings;
+  bool inLargerThanLife = false;
+  size_t begin = 0;
+  while (begin <= value.size()) {
+    const size_t end = std::min(value.find(',', begin), value.size());
+    const std::string part = value.substr(begin, end - begin);
+    begin = end + 1;
+
+    const char field =
+        part.empty() ? '\0'
+                     : static_cast<char>(std::tolower(
+                           static_cast<unsigned char>(part[0])));
+    const bool numbered =
+        part.size() > 1 && std::isdigit(static_cast<unsigned char>(part[1]));
+    if (inLargerThanLife && part.find('/') == std::string::npos &&
+        (field == 'n' || (numbered && std::string("cmsb").find(field) !=
+                                          std::string::npos))) {
+      rulestrings.back() += "," + part;
+      inLargerThanLife = field != 'n';
+    } else {
+      rulestrings.push_back(part);
+      inLargerThanLife = field == 'r' && numbered;
+    }
+  }
+  return rulestrings;
+}
+}  // namespace
+
 Control::Control() {
   _log.console("{ CTR }", "constructing Control");
 }
@@ -15,39 +51,377 @@ Control::~Control() {
   _log.console("{ CTR }", "destructing Control");
 }
 
-auto lastTime = std::chrono::high_resolution_clock::now();
-void Control::setPassedHours() {
-  auto currentTime = std::chrono::high_resolution_clock::now();
+// --backend cells|packed|cpu  --threads <count>  --headless <generations>
+// --grid <width>x<height>  --density <alive fraction>  --workgroup <size>
+// --report <file>  --rule <rulestring>[,<rulestring>...]
+// --speed <generations per second>|unlimited  --frame-budget <ms>
+// --ring <buffers>  --prerecord on|off  --history <generations>
+// --keyframes <interval>x<count>  --load <checkpoint>  --save <checkpoint>
+// --record <file>  --record-every <generations>  --record-buffers <count>
+// --statistics on|off  --pattern <file>  --seed <number>
+// --cross-check on|off
+void Control::parseArguments(int argc, char* argv[]) {
+  float density = -1.0f;
+  grid.seed = std::random_device{}();
 
-  if (currentTime - lastTime >=
-      std::chrono::duration_cast<std::chrono::high_resolution_clock::duration>(
-          std::chrono::duration<float>(1.0 / timer.speed))) {
-    timer.passedHours++;
-    lastTime = currentTime;
-  };
-  return;
+  for (int i = 1; i < argc; i++) {
+    const std::string argument = argv[i];
+    if (i + 1 >= argc) {
+      throw std::runtime_error("\n!ERROR! Missing value for " + argument);
+    }
+    const std::string value = argv[++i];
+
+    if (argument == "--backend") {
+      if (value == "cells") {
+        simulation.backend = Simulation::Backend::cells;
+      } else if (value == "packed") {
+        simulation.backend = Simulation::Backend::packed;
+      } else if (value == "cpu") {
+        simulation.backend = Simulation::Backend::cpu;
+      } else {
+        throw std::runtime_error("\n!ERROR! Unknown backend " + value);
+      }
+    } else if (argument == "--threads") {
+      simulation.cpuThreads = static_cast<uint32_t>(std::stoul(value));
+    } else if (argument == "--headless") {
+      simulation.headless = true;
+      simulation.targetGeneration = std::stoull(value);
+    } else if (argument == "--grid") {
+      const size_t separator = value.find('x');
+      if (separator == std::string::npos) {
+        throw std::runtime_error("\n!ERROR! Grid must be <width>x<height>");
+      }
+      grid.dimensions = {
+          static_cast<uint_fast16_t>(std::stoul(value.substr(0, separator))),
+          static_cast<uint_fast16_t>(std::stoul(value.substr(separator + 1)))};
+    } else if (argument == "--density") {
+      density = std::stof(value);
+    } else if (argument == "--seed") {
+      grid.seed = std::stoull(value);
+    } else if (argument == "--workgroup") {
+      compute.localSizeX = static_cast<uint32_t>(std::stoul(value));
+      compute.localSizeY = compute.localSizeX;
+    } else if (argument == "--speed") {
+      timer.speed = value == "unlimited" ? 0.0f : std::stof(value);
+    } else if (argument == "--frame-budget") {
+      timer.frameBudget = std::stof(value);
+    } else if (argument == "--ring") {
+      timer.ringSize = static_cast<uint32_t>(std::stoul(value));
+    } else if (argument == "--prerecord") {
+      if (value != "on" && value != "off") {
+        throw std::runtime_error("\n!ERROR! --prerecord must be on or off");
+      }
+      simulation.prerecorded = value == "on";
+    } else if (argument == "--history") {
+      history.length = static_cast<uint32_t>(std::stoul(value));
+    } else if (argument == "--keyframes") {
+      const size_t separator = value.find('x');
+      if (separator == std::string::npos) {
+        throw std::runtime_error(
+            "\n!ERROR! Keyframes must be <interval>x<count>");
+      }
+      history.keyframeInterval =
+          static_cast<uint32_t>(std::stoul(value.substr(0, separator)));
+      history.keyframeCount =
+          static_cast<uint32_t>(std::stoul(value.substr(separator + 1)));
+    } else if (argument == "--load") {
+      checkpoint.loadPath = value;
+    } else if (argument == "--save") {
+      checkpoint.savePath = value;
+    } else if (argument == "--pattern") {
+      pattern.path = value;
+    } else if (argument == "--record") {
+      recording.path = value;
+    } else if (argument == "--record-every") {
+      recording.interval = static_cast<uint32_t>(std::stoul(value));
+    } else if (argument == "--record-buffers") {
+      recording.bufferCount = static_cast<uint32_t>(std::stoul(value));
+    } else if (argument == "--statistics") {
+      if (value != "on" && value != "off") {
+        throw std::runtime_error("\n!ERROR! --statistics must be on or off");
+      }
+      statistics.enabled = value == "on";
+    } else if (argument == "--cross-check") {
+      if (value != "on" && value != "off") {
+        throw std::runtime_error("\n!ERROR! --cross-check must be on or off");
+      }
+      simulation.crossChecked = value == "on";
+    } else if (argument == "--report") {
+      benchmark.reportPath = value;
+    } else if (argument == "--rule") {
+      rules.available.clear();
+      rules.current = 0;
+      for (const std::string& rulestring : splitRules(value)) {
+        rules.available.push_back(parseRule(rulestring));
+      }
+    } else {
+      throw std::runtime_error("\n!ERROR! Unknown argument " + argument);
+    }
+  }
+
+  if (timer.ringSize < 2) {
+    throw std::runtime_error("\n!ERROR! The ring needs at least 2 buffers");
+  }
+  if (simulation.prerecorded &&
+      simulation.backend != Simulation::Backend::cells) {
+    throw std::runtime_error(
+        "\n!ERROR! Prerecorded command buffers need the cells backend");
+  }
+  if (history.length > 0) {
+    if (simulation.backend != Simulation::Backend::cells) {
+      throw std::runtime_error("\n!ERROR! The history needs the cells backend");
+    }
+    if (history.keyframeInterval == 0 || history.keyframeCount == 0) {
+      throw std::runtime_error("\n!ERROR! The history needs keyframes");
+    }
+  }
+  if (statistics.enabled && simulation.backend != Simulation::Backend::cells) {
+    throw std::runtime_error("\n!ERROR! Statistics need the cells backend");
+  }
+  if (simulation.crossChecked &&
+      (!simulation.headless ||
+       simulation.backend != Simulation::Backend::cells ||
+       hasLargerThanLifeRule())) {
+    throw std::runtime_error(
+        "\n!ERROR! Cross-checking needs a headless Life-like cells run");
+  }
+  if (!pattern.path.empty() && !checkpoint.loadPath.empty()) {
+    throw std::runtime_error(
+        "\n!ERROR! Load either a pattern or a checkpoint, not both");
+  }
+  // Which generations are recorded changes from frame to frame
+  if (!recording.path.empty()) {
+    if (simulation.backend != Simulation::Backend::cells ||
+        simulation.prerecorded) {
+      throw std::runtime_error(
+          "\n!ERROR! Recording needs the cells backend without prerecording");
+    }
+    if (recording.interval == 0 || recording.bufferCount == 0) {
+      throw std::runtime_error(
+          "\n!ERROR! Recording needs an interval and buffers");
+    }
+  }
+
+  if (density >= 0.0f) {
+    grid.totalAliveCells = static_cast<uint_fast32_t>(
+        density * grid.dimensions[0] * grid.dimensions[1]);
+  }
+
+  checkRules();
 }
 
-void Control::setPushConstants() {
-  _memory.pushConstants.data = {_control.timer.passedHours};
+// Larger than Life rules only run on the cells backend and their box must
+// fit into the grid
+void Control::checkRules() const {
+  for (const Rule& rule : rules.available) {
+    if (rule.radius == 1) {
+      continue;
+    }
+    if (simulation.backend != Simulation::Backend::cells) {
+      throw std::runtime_error("\n!ERROR! " + rule.name +
+                               " needs the cells backend");
+    }
+    if (2 * rule.radius + 1 >
+        std::min(grid.dimensions[0], grid.dimensions[1])) {
+      throw std::runtime_error("\n!ERROR! Radius of " + rule.name +
+                               " exceeds the grid");
+    }
+  }
 }
 
-std::vector<uint_fast32_t> Control::setCellsAliveRandomly(
-    uint_fast32_t numberOfCells) {
-  std::vector<uint_fast32_t> CellIDs;
-  CellIDs.reserve(numberOfCells);
+// Accepts B<digits>/S<digits> in either order and case, the S/B form
+// <survival>/<birth>, Larger than Life rules as R<r>,C0,M<0|1>,S<a>..<b>,
+// B<c>..<d>,NM and a few names. Birth on zero neighbours is rejected, the
+// packed backend skips unchanged tiles and HashLife relies on empty space
+// staying empty.
+Control::Rule Control::parseRule(const std::string& rulestring) {
+  static const std::array<std::pair<const char*, const char*>, 6> names{
+      {{"life", "B3/S23"},
+       {"highlife", "B36/S23"},
+       {"daynight", "B3678/S34678"},
+       {"seeds", "B2/S"},
+       {"maze", "B3/S12345"},
+       {"bosco", "R5,C0,M1,S34..58,B34..45,NM"}}};
+  std::string lower;
+  for (char c : rulestring) {
+    lower += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+  }
+  for (const auto& [name, alias] : names) {
+    if (lower == name) {
+      return parseRule(alias);
+    }
+  }
 
-  std::random_device random;
-  std::mt19937 generate(random());
-  std::uniform_int_distribution<int> distribution(
-      0, _control.grid.dimensions[0] * _control.grid.dimensions[1] - 1);
+  if (lower.starts_with('r') && lower.find(',') != std::string::npos) {
+    return parseLargerThanLife(lower);
+  }
 
-  while (CellIDs.size() < numberOfCells) {
-    int CellID = distribution(generate);
-    if (std::find(CellIDs.begin(), CellIDs.end(), CellID) == CellIDs.end()) {
-      CellIDs.push_back(CellID);
+  const size_t slash = lower.find('/');
+  if (slash == std::string::npos) {
+    throw std::runtime_error("\n!ERROR! Rule must be B<n>/S<n>: " +
+                             rulestring);
+  }
+  std::string birthPart = lower.substr(0, slash);
+  std::string survivalPart = lower.substr(slash + 1);
+  if (birthPart.starts_with('s') || survivalPart.starts_with('b')) {
+    std::swap(birthPart, survivalPart);
+  } else if (!birthPart.starts_with('b')) {
+    // S/B notation lists survival first
+    std::swap(birthPart, survivalPart);
+    birthPart.insert(0, "b");
+    survivalPart.insert(0, "s");
+  }
+  if (!birthPart.starts_with('b') || !survivalPart.starts_with('s')) {
+    throw std::runtime_error("\n!ERROR! Rule must be B<n>/S<n>: " +
+                             rulestring);
+  }
+
+  auto getMask = [&rulestring](const std::string& counts) {
+    uint32_t mask = 0;
+    for (char digit : counts.substr(1)) {
+      if (digit < '0' || digit > '8') {
+        throw std::runtime_error("\n!ERROR! Invalid neighbour count in " +
+                                 rulestring);
+      }
+      mask |= 1u << (digit - '0');
+    }
+    return mask;
+  };
+  Rule rule{.name = "B",
+            .birth = getMask(birthPart),
+            .survival = getMask(survivalPart)};
+  if (rule.birth & 0x1u) {
+    throw std::runtime_error("\n!ERROR! B0 rules are not supported: " +
+                             rulestring);
+  }
+
+  for (uint32_t n = 0; n <= 8; n++) {
+    if (rule.birth >> n & 1u) {
+      rule.name += static_cast<char>('0' + n);
+    }
+  }
+  rule.name += "/S";
+  for (uint32_t n = 0; n <= 8; n++) {
+    if (rule.survival >> n & 1u) {
+      rule.name += static_cast<char>('0' + n);
+    }
+  }
+  return rule;
+}
+
+// Golly's notation, C0 and C2 both mean two states. Radius 1 rules become
+// masks so they run on the cheaper 8 neighbour path.
+Control::Rule Control::parseLargerThanLife(const std::string& rulestring) {
+  Rule rule{.name = "", .birth = 0, .survival = 0, .radius = 0};
+  bool hasBirth = false;
+  bool hasSurvival = false;
+
+  auto getRange = [&rulestring](const std::string& value) {
+    const size_t dots = value.find("..");
+    if (dots == std::string::npos) {
+      throw std::runtime_error("\n!ERROR! Range must be <min>..<max> in " +
+                               rulestring);
+    }
+    return std::array<uint32_t, 2>{
+        static_cast<uint32_t>(std::stoul(value.substr(0, dots))),
+        static_cast<uint32_t>(std::stoul(value.substr(dots + 2)))};
+  };
+
+  size_t begin = 0;
+  while (begin < rulestring.size()) {
+    const size_t end = std::min(rulestring.find(',', begin), rulestring.size());
+    const std::string part = rulestring.substr(begin, end - begin);
+    begin = end + 1;
+    if (part.empty()) {
+      continue;
     }
+    const std::string value = part.substr(1);
+    switch (part[0]) {
+      case 'r':
+        rule.radius = static_cast<uint32_t>(std::stoul(value));
+        break;
+      case 'c':
+        if (value != "0" && value != "2") {
+          throw std::runtime_error("\n!ERROR! Only two states supported: " +
+                                   rulestring);
+        }
+        break;
+      case 'm':
+        rule.includeCenter = value == "1";
+        break;
+      case 's':
+        rule.survivalRange = getRange(value);
+        hasSurvival = true;
+        break;
+      case 'b':
+        rule.birthRange = getRange(value);
+        hasBirth = true;
+        break;
+      case 'n':
+        if (value != "m") {
+          throw std::runtime_error("\n!ERROR! Only the Moore neighbourhood "
+                                   "is supported: " +
+                                   rulestring);
+        }
+        break;
+      default:
+        throw std::runtime_error("\n!ERROR! Unknown field " + part + " in " +
+                                 rulestring);
+    }
+  }
+  if (rule.radius == 0 || !hasBirth || !hasSurvival) {
+    throw std::runtime_error("\n!ERROR! Rule needs R, S and B: " +
+                             rulestring);
   }
-  std::sort(CellIDs.begin(), CellIDs.end());
-  return CellIDs;
+
+  const uint32_t center = rule.includeCenter ? 1 : 0;
+  if (rule.radius == 1) {
+    // Survival counts include an alive center, birth counts a dead one
+    std::string masks = "B";
+    for (uint32_t n = rule.birthRange[0]; n <= std::min(rule.birthRange[1], 8u);
+         n++) {
+      masks += std::to_string(n);
+    }
+    masks += "/S";
+    for (uint32_t n = std::max(rule.survivalRange[0], center);
+         n <= std::min(rule.survivalRange[1], 8 + center); n++) {
+      masks += std::to_string(n - center);
+    }
+    return parseRule(masks);
+  }
+  if (rule.birthRange[0] == 0) {
+    throw std::runtime_error("\n!ERROR! B0 rules are not supported: " +
+                             rulestring);
+  }
+
+  rule.name = "R" + std::to_string(rule.radius) + ",C0,M" +
+              std::to_string(center) + ",S" +
+              std::to_string(rule.survivalRange[0]) + ".." +
+              std::to_string(rule.survivalRange[1]) + ",B" +
+              std::to_string(rule.birthRange[0]) + ".." +
+              std::to_string(rule.birthRange[1]) + ",NM";
+  return rule;
+}
+
+const Control::Rule& Control::getRule() const {
+  return rules.available[rules.current];
+}
+
+bool Control::hasLargerThanLifeRule() const {
+  return std::any_of(rules.available.begin(), rules.available.end(),
+                     [](const Rule& rule) { return rule.radius > 1; });
+}
+
+void Control::setPushConstants() {
+  _memory.pushConstants.data = {_control.timer.passedHours,
+                                 _control.simulation.generation};
+}
+
+// A cell is alive when its draw of Random::Stream::alive is below
+uint32_t Control::getAliveThreshold() const {
+  const double cells =
+      static_cast<double>(grid.dimensions[0]) * grid.dimensions[1];
+  const double fraction = std::min(grid.totalAliveCells / cells, 1.0);
+  return static_cast<uint32_t>(
+      std::min(fraction * 4294967296.0, 4294967295.0));
 }
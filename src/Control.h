@@ -11,16 +11,27 @@ class Control {
   Control();
   ~Control();
 
+  // The scheduler aims for speed generations per second, 0 is unlimited,
+  // with at most frameBudget milliseconds of compute per frame. Generations
+  // are written round a ring of ringSize cell buffers, at least 2. Paused
+  // frames compute none, the P key toggles it.
   struct Timer {
     float speed = 30.0f;
     uint64_t passedHours{0};
+    float frameBudget = 8.0f;
+    uint32_t ringSize{4};
+    bool paused{false};
   } timer;
 
+  // Cells start alive with probability totalAliveCells over the grid size
+  // and tiles with heights up to height in heightSteps steps, drawn from seed,
+  // see Random. The same seed always gives the same world.
   struct Grid {
     uint_fast32_t totalAliveCells = 30000;
     std::array<uint_fast16_t, 2> dimensions = {250, 250};
     float height = 0.5f;
     int heightSteps = 10;
+    uint64_t seed{0};
   } grid;
 
   struct DisplayConfiguration {
@@ -29,15 +40,113 @@ class Control {
     uint16_t height = 1080;
   } display;
 
+  struct Simulation {
+    enum class Backend { cells, packed, cpu };
+    Backend backend{Backend::cells};
+    // CPU backend worker threads, 0 uses every hardware thread
+    uint32_t cpuThreads{0};
+    // Compute only run up to targetGeneration without window or swap chain
+    bool headless{false};
+    uint64_t generation{0};
+    // Packed backend: generations advanced per scheduled step, and a generation
+    // to fast forward to in batches of at most maxGenerationsPerSubmit
+    uint32_t generationsPerStep{1};
+    uint64_t targetGeneration{0};
+    uint32_t maxGenerationsPerSubmit{256};
+    // Packed backend: HashLife jumps 2^hashLifeJump generations on the H key
+    uint32_t hashLifeJump{10};
+    // Cells backend: submit command buffers recorded once at startup
+    // instead of recording every frame
+    bool prerecorded{false};
+    // Headless cells backend: step the CPU backend over the same generations
+    // from the same cells and compare the results
+    bool crossChecked{false};
+  } simulation;
+
+  // Workgroup size of every compute shader, specialization constants 0 and 1.
+  // localSizeX * localSizeY must not exceed maxComputeWorkGroupInvocations.
+  // Each invocation of the Larger than Life sum passes slides its window over
+  // runLength cells, specialization constant 10.
   struct Compute {
-    const uint8_t localSizeX{32};
-    const uint8_t localSizeY{32};
-    const uint8_t localSizeZ{1};
+    uint32_t localSizeX{32};
+    uint32_t localSizeY{32};
+    const uint32_t localSizeZ{1};
+    const uint32_t runLength{64};
   } compute;
 
+  // Life-like rules, bit n of birth or survival is set when n alive
+  // neighbours give birth to a dead cell or keep an alive cell alive. The
+  // masks are specialization constants 2 and 3 of the compute shaders.
+  // Larger than Life rules have a radius above 1 and count the alive cells
+  // of the (2 * radius + 1)^2 box, with the center cell when includeCenter,
+  // against the inclusive birth and survival ranges instead. Constants 4 to 9.
+  struct Rule {
+    std::string name{"B3/S23"};
+    uint32_t birth{0x8};
+    uint32_t survival{0xC};
+    uint32_t radius{1};
+    bool includeCenter{false};
+    std::array<uint32_t, 2> birthRange{3, 3};
+    std::array<uint32_t, 2> survivalRange{2, 3};
+  };
+  // Rules that get pipelines at startup, the R key cycles through them
+  struct Rules {
+    std::vector<Rule> available{Rule{}};
+    size_t current{0};
+  } rules;
+
+  // Cells backend: snapshots of the last length generations, 0 keeps none,
+  // and of every keyframeInterval-th generation in keyframeCount more, see
+  // History. Specialization constants 11 to 13.
+  struct History {
+    uint32_t length{0};
+    uint32_t keyframeInterval{64};
+    uint32_t keyframeCount{16};
+  } history;
+
+  // Checkpoint to resume from, and the file the C key and the end of a
+  // headless run write, see Checkpoint
+  struct Checkpoints {
+    std::string loadPath;
+    std::string savePath;
+  } checkpoint;
+
+  // RLE, Life 1.06, plaintext or Macrocell file to start from, centred on
+  // the grid, see Pattern
+  struct Patterns {
+    std::string path;
+  } pattern;
+
+  // Cells backend: the changes of every interval-th generation are streamed
+  // to path through a ring of bufferCount readback buffers, see Recorder
+  struct Recording {
+    std::string path;
+    uint32_t interval{1};
+    uint32_t bufferCount{8};
+  } recording;
+
+  // Cells backend: shader.comp reduces population, births, deaths and a
+  // neighbour histogram every generation, see Statistics. Specialization
+  // constant 14.
+  struct Statistics {
+    bool enabled{false};
+  } statistics;
+
+  // Headless runs append one JSON line with their results, see CapitalBench
+  struct Benchmark {
+    std::string reportPath;
+  } benchmark;
+
  public:
-  std::vector<uint_fast32_t> setCellsAliveRandomly(uint_fast32_t numberOfCells);
-  void setPassedHours();
+  void parseArguments(int argc, char* argv[]);
+  static Rule parseRule(const std::string& rulestring);
+  const Rule& getRule() const;
+  bool hasLargerThanLifeRule() const;
+  void checkRules() const;
+  uint32_t getAliveThreshold() const;
 
   void setPushConstants();
+
+ private:
+  static Rule parseLargerThanLife(const std::string& rulestring);
 };
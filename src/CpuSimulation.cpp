@@ -0,0 +1,139 @@
+#include <algorithm>
+#include <chrono>
+
+#include "CapitalEngine.h"
+#include "CpuSimulation.h"
+
+namespace {
+// Same rules as simulate() in shader.comp
+inline uint32_t nextState(uint32_t state,
+                          uint32_t neighbours,
+                          const Control::Rule& rule,
+                          uint32_t hour,
+                          uint32_t cycle) {
+  const bool isAlive = (state & 0x1u) != 0;
+  const bool isSeeded = (state & 0x80u) != 0;
+  const uint32_t cycleIn = (state >> 2) & 0x1Fu;
+
+  bool nextAlive, nextStage;
+  if ((state & 0x2u) == 0) {
+    nextAlive = isAlive && (isSeeded || cycleIn <= 24);
+    nextStage = !(isAlive && (isSeeded || cycleIn < 24));
+  } else {
+    nextAlive = ((isAlive ? rule.survival : rule.birth) >> neighbours) & 1u;
+    nextStage = !nextAlive && !isAlive;
+  }
+  const uint32_t next = static_cast<uint32_t>(nextAlive) |
+                        (static_cast<uint32_t>(nextStage) << 1) |
+                        (cycle << 2) | (hour << 8);
+  return (state >> 8) == hour ? state : next;
+}
+}  // namespace
+
+CpuSimulation::CpuSimulation() : statistics{}, width{0}, height{0} {
+  _log.console("{ CPU }", "constructing CPU Simulation");
+}
+
+CpuSimulation::~CpuSimulation() {
+  _log.console("{ CPU }", "destructing CPU Simulation");
+}
+
+void CpuSimulation::load(const std::vector<World::Cell>& cells,
+                         uint32_t threadCount) {
+  width = _control.grid.dimensions[0];
+  height = _control.grid.dimensions[1];
+  cellsIn = cells;
+  cellsOut = cells;
+
+  if (threadCount == 0) {
+    threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+  }
+  if (!threadPool || threadPool->getThreadCount() != threadCount) {
+    threadPool = std::make_unique<ThreadPool>(threadCount);
+  }
+  _log.console("{ CPU }", "simulating", width, "*", height, "cells on",
+               threadCount, "threads");
+}
+
+// One compute dispatch: reads the last step and writes the next one
+void CpuSimulation::step(uint64_t passedHours) {
+  const auto start = std::chrono::steady_clock::now();
+
+  const uint32_t hour = static_cast<uint32_t>(passedHours) & 0xFFFFFFu;
+  const uint32_t cycle = static_cast<uint32_t>(passedHours % 24) + 1;
+  std::swap(cellsIn, cellsOut);
+
+  const uint32_t bandCount = (height + rowsPerBand - 1) / rowsPerBand;
+  threadPool->parallelFor(bandCount, [&](uint32_t band) {
+    stepBand(band, hour, cycle);
+  });
+
+  statistics.steps++;
+  statistics.seconds += std::chrono::duration<double>(
+                            std::chrono::steady_clock::now() - start)
+                            .count();
+  if (statistics.steps % stepsPerReport == 0) {
+    logThroughput();
+  }
+}
+
+const std::vector<World::Cell>& CpuSimulation::getCells() const {
+  return cellsOut;
+}
+
+// Neighbour counts come from three rows of alive flags summed vertically into
+// a column row padded with the wrapped edge columns, then horizontally
+void CpuSimulation::stepBand(uint32_t band, uint32_t hour, uint32_t cycle) {
+  thread_local std::vector<uint8_t> above, centre, below, columns;
+  above.resize(width);
+  centre.resize(width);
+  below.resize(width);
+  columns.resize(static_cast<size_t>(width) + 2);
+
+  const Control::Rule& rule = _control.getRule();
+  const uint32_t firstRow = band * rowsPerBand;
+  const uint32_t lastRow = std::min(firstRow + rowsPerBand, height);
+
+  setNeighbourFlags((firstRow + height - 1) % height, above);
+  setNeighbourFlags(firstRow, centre);
+
+  for (uint32_t y = firstRow; y < lastRow; y++) {
+    setNeighbourFlags((y + 1) % height, below);
+
+    const uint8_t* up = above.data();
+    const uint8_t* middle = centre.data();
+    const uint8_t* down = below.data();
+    uint8_t* column = columns.data();
+    for (uint32_t x = 0; x < width; x++) {
+      column[x + 1] = up[x] + middle[x] + down[x];
+    }
+    column[0] = column[width];
+    column[width + 1] = column[1];
+
+    const World::Cell* in = cellsIn.data() + static_cast<size_t>(y) * width;
+    World::Cell* out = cellsOut.data() + static_cast<size_t>(y) * width;
+    for (uint32_t x = 0; x < width; x++) {
+      const uint32_t neighbours =
+          column[x] + column[x + 1] + column[x + 2] - middle[x];
+      out[x].state = nextState(in[x].state, neighbours, rule, hour, cycle);
+    }
+
+    std::swap(above, centre);
+    std::swap(centre, below);
+  }
+}
+
+// A neighbour counts when it is alive in the second stage
+void CpuSimulation::setNeighbourFlags(uint32_t row,
+                                      std::vector<uint8_t>& flags) const {
+  const World::Cell* cells = cellsIn.data() + static_cast<size_t>(row) * width;
+  for (uint32_t x = 0; x < width; x++) {
+    flags[x] = (cells[x].state & 0x3u) == 0x3u;
+  }
+}
+
+void CpuSimulation::logThroughput() {
+  const double cells = static_cast<double>(width) * height * statistics.steps;
+  _log.console("{ CPU }", statistics.steps, "steps at",
+               cells / statistics.seconds / 1.0e6, "M cells/s");
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "ThreadPool.h"
+#include "World.h"
+
+// Bit-exact CPU version of shader.comp on the World::Cell layout, for hosts
+// without a GPU and to cross-check the compute shader, see --cross-check.
+// The grid is cut into bands of rows that the thread pool shares out. The
+// neighbour counts of a row are summed from byte flags in branch free loops
+// the compiler may vectorise; the state update of each cell then branches on
+// its stage like simulate() does.
+class CpuSimulation {
+ public:
+  CpuSimulation();
+  ~CpuSimulation();
+
+  struct Statistics {
+    uint64_t steps{0};
+    double seconds{0.0};
+  } statistics;
+
+ public:
+  void load(const std::vector<World::Cell>& cells, uint32_t threadCount);
+  void step(uint64_t passedHours);
+  const std::vector<World::Cell>& getCells() const;
+
+ private:
+  inline static const uint32_t rowsPerBand{16};
+  inline static const uint64_t stepsPerReport{256};
+
+  uint32_t width;
+  uint32_t height;
+  std::vector<World::Cell> cellsIn;
+  std::vector<World::Cell> cellsOut;
+  std::unique_ptr<ThreadPool> threadPool;
+
+  void stepBand(uint32_t band, uint32_t hour, uint32_t cycle);
+  void setNeighbourFlags(uint32_t row, std::vector<uint8_t>& flags) const;
+  void logThroughput();
+};
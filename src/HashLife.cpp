@@ -0,0 +1,383 @@
+#include <algorithm>
+#include <array>
+
+#include "CapitalEngine.h"
+#include "HashLife.h"
+
+HashLife::HashLife()
+    : statistics{}, root{deadLeaf}, birth{0}, survival{0} {
+  _log.console("{ HLF }", "constructing HashLife");
+  reset();
+}
+
+HashLife::~HashLife() {
+  _log.console("{ HLF }", "destructing HashLife");
+}
+
+// Keeps the node store, and with it every memoised result, so loading the
+// same pattern again reuses the work of earlier steps. A changed rule starts
+// over with an empty store.
+void HashLife::load(const std::vector<World::Cell>& cells,
+                    uint32_t width,
+                    uint32_t height) {
+  const Control::Rule& rule = _control.getRule();
+  if (rule.birth != birth || rule.survival != survival) {
+    birth = rule.birth;
+    survival = rule.survival;
+    reset();
+  }
+
+  uint8_t level = 3;
+  while ((int64_t{1} << (level - 1)) < std::max(width, height)) {
+    level++;
+  }
+  const int64_t half = int64_t{1} << (level - 1);
+  root = build(cells, width, height, level, -half, -half);
+}
+
+// Advances the plane by 2^log2Generations generations in one result
+void HashLife::step(uint32_t log2Generations) {
+  if (nodes.size() > maxNodes) {
+    collectGarbage();
+  }
+
+  while (nodes[root].level < log2Generations + 2 || !isCentred(root)) {
+    root = expand(root);
+  }
+  // Room for the pattern to grow by 2^log2Generations cells on every side
+  root = expand(root);
+  root = result(root, static_cast<uint8_t>(log2Generations));
+
+  statistics.nodes = nodes.size();
+  statistics.nodeMemory = nodes.capacity() * sizeof(Node) +
+                          slots.capacity() * sizeof(uint32_t);
+}
+
+std::vector<World::Cell> HashLife::extract(uint32_t width, uint32_t height) {
+  std::vector<World::Cell> cells(static_cast<size_t>(width) * height, {0});
+  const int64_t half = int64_t{1} << (nodes[root].level - 1);
+  fill(cells, width, height, root, -half, -half);
+  return cells;
+}
+
+uint64_t HashLife::getPopulation() const {
+  return nodes[root].population;
+}
+
+void HashLife::logStatistics() {
+  const double hitRate =
+      statistics.cacheLookups == 0
+          ? 0.0
+          : 100.0 * static_cast<double>(statistics.cacheHits) /
+                static_cast<double>(statistics.cacheLookups);
+
+  _log.console("{ HLF }", "population", getPopulation());
+  _log.console(_log.style.charLeader, statistics.nodes, "nodes in",
+               statistics.nodeMemory / 1024, "KiB");
+  _log.console(_log.style.charLeader, "result cache hit rate", hitRate, "% of",
+               statistics.cacheLookups, "lookups");
+  _log.console(_log.style.charLeader, statistics.collections,
+               "garbage collections");
+}
+
+uint32_t HashLife::join(uint32_t nw, uint32_t ne, uint32_t sw, uint32_t se) {
+  size_t mask = slots.size() - 1;
+  size_t slot = hashChildren(nw, ne, sw, se) & mask;
+  while (slots[slot] != emptySlot) {
+    const Node& node = nodes[slots[slot]];
+    if (node.nw == nw && node.ne == ne && node.sw == sw && node.se == se) {
+      return slots[slot];
+    }
+    slot = (slot + 1) & mask;
+  }
+
+  const uint32_t index = static_cast<uint32_t>(nodes.size());
+  nodes.push_back({.nw = nw,
+                   .ne = ne,
+                   .sw = sw,
+                   .se = se,
+                   .population = nodes[nw].population + nodes[ne].population +
+                                 nodes[sw].population + nodes[se].population,
+                   .result = deadLeaf,
+                   .level = static_cast<uint8_t>(nodes[nw].level + 1),
+                   .resultStep = noResult});
+  slots[slot] = index;
+
+  if (nodes.size() * 2 > slots.size()) {
+    rehash(slots.size() * 2);
+  }
+  return index;
+}
+
+uint32_t HashLife::getEmpty(uint8_t level) {
+  while (emptyNodes.size() <= level) {
+    const uint32_t child = emptyNodes.back();
+    emptyNodes.push_back(join(child, child, child, child));
+  }
+  return emptyNodes[level];
+}
+
+// Same pattern, one level up and centred
+uint32_t HashLife::expand(uint32_t node) {
+  const Node n = nodes[node];
+  const uint32_t empty = getEmpty(n.level - 1);
+  return join(join(empty, empty, empty, n.nw), join(empty, empty, n.ne, empty),
+              join(empty, n.sw, empty, empty), join(n.se, empty, empty, empty));
+}
+
+uint32_t HashLife::centre(uint32_t node) {
+  const Node n = nodes[node];
+  return join(nodes[n.nw].se, nodes[n.ne].sw, nodes[n.sw].ne, nodes[n.se].nw);
+}
+
+bool HashLife::isCentred(uint32_t node) {
+  const Node n = nodes[node];
+  return nodes[nodes[n.nw].se].population + nodes[nodes[n.ne].sw].population +
+             nodes[nodes[n.sw].ne].population +
+             nodes[nodes[n.se].nw].population ==
+         n.population;
+}
+
+// Centre of the node, half its size, 2^log2Generations generations later.
+// Valid for log2Generations <= level - 2.
+uint32_t HashLife::result(uint32_t node, uint8_t log2Generations) {
+  const Node n = nodes[node];
+  if (n.population == 0) {
+    return getEmpty(n.level - 1);
+  }
+  statistics.cacheLookups++;
+  if (n.resultStep == log2Generations) {
+    statistics.cacheHits++;
+    return n.result;
+  }
+
+  uint32_t next;
+  if (n.level == 2) {
+    next = resultLevel2(node);
+  } else {
+    const Node nw = nodes[n.nw];
+    const Node ne = nodes[n.ne];
+    const Node sw = nodes[n.sw];
+    const Node se = nodes[n.se];
+
+    // Nine overlapping subnodes of half the size
+    std::array<uint32_t, 9> sub{n.nw,
+                                join(nw.ne, ne.nw, nw.se, ne.sw),
+                                n.ne,
+                                join(nw.sw, nw.se, sw.nw, sw.ne),
+                                join(nw.se, ne.sw, sw.ne, se.nw),
+                                join(ne.sw, ne.se, se.nw, se.ne),
+                                n.sw,
+                                join(sw.ne, se.nw, sw.se, se.sw),
+                                n.se};
+
+    // At full speed both halves advance, otherwise only the second does
+    const bool fullSpeed = log2Generations == n.level - 2;
+    const uint8_t halfStep =
+        fullSpeed ? static_cast<uint8_t>(n.level - 3) : log2Generations;
+    for (uint32_t& s : sub) {
+      s = fullSpeed ? result(s, halfStep) : centre(s);
+    }
+
+    next = join(result(join(sub[0], sub[1], sub[3], sub[4]), halfStep),
+                result(join(sub[1], sub[2], sub[4], sub[5]), halfStep),
+                result(join(sub[3], sub[4], sub[6], sub[7]), halfStep),
+                result(join(sub[4], sub[5], sub[7], sub[8]), halfStep));
+  }
+
+  nodes[node].result = next;
+  nodes[node].resultStep = log2Generations;
+  return next;
+}
+
+// One generation of the inner 2x2 cells of a 4x4 node
+uint32_t HashLife::resultLevel2(uint32_t node) {
+  const Node n = nodes[node];
+  uint32_t bits = 0;
+  const std::array<uint32_t, 4> quadrants{n.nw, n.ne, n.sw, n.se};
+  for (uint32_t q = 0; q < 4; q++) {
+    const Node child = nodes[quadrants[q]];
+    const std::array<uint32_t, 4> leaves{child.nw, child.ne, child.sw,
+                                         child.se};
+    for (uint32_t l = 0; l < 4; l++) {
+      const uint32_t x = (q % 2) * 2 + l % 2;
+      const uint32_t y = (q / 2) * 2 + l / 2;
+      bits |= (leaves[l] == aliveLeaf ? 1u : 0u) << (y * 4 + x);
+    }
+  }
+
+  std::array<uint32_t, 4> next{};
+  for (uint32_t i = 0; i < 4; i++) {
+    const uint32_t x = 1 + i % 2;
+    const uint32_t y = 1 + i / 2;
+    uint32_t neighbours = 0;
+    for (uint32_t ny = y - 1; ny <= y + 1; ny++) {
+      for (uint32_t nx = x - 1; nx <= x + 1; nx++) {
+        if (nx != x || ny != y) {
+          neighbours += (bits >> (ny * 4 + nx)) & 1u;
+        }
+      }
+    }
+    const bool isAlive = (bits >> (y * 4 + x)) & 1u;
+    next[i] = ((isAlive ? survival : birth) >> neighbours) & 1u ? aliveLeaf
+                                                                : deadLeaf;
+  }
+  return join(next[0], next[1], next[2], next[3]);
+}
+
+// Cell (0, 0) of the grid sits at (-width / 2, -height / 2) on the plane
+uint32_t HashLife::build(const std::vector<World::Cell>& cells,
+                         uint32_t width,
+                         uint32_t height,
+                         uint8_t level,
+                         int64_t x,
+                         int64_t y) {
+  const int64_t left = -static_cast<int64_t>(width / 2);
+  const int64_t top = -static_cast<int64_t>(height / 2);
+  const int64_t size = int64_t{1} << level;
+  if (x + size <= left || y + size <= top || x >= left + width ||
+      y >= top + height) {
+    return getEmpty(level);
+  }
+
+  if (level == 0) {
+    const size_t index = static_cast<size_t>(y - top) * width + (x - left);
+    return cells[index].state & 1u ? aliveLeaf : deadLeaf;
+  }
+
+  const uint8_t childLevel = level - 1;
+  const int64_t half = size / 2;
+  const uint32_t nw = build(cells, width, height, childLevel, x, y);
+  const uint32_t ne = build(cells, width, height, childLevel, x + half, y);
+  const uint32_t sw = build(cells, width, height, childLevel, x, y + half);
+  const uint32_t se =
+      build(cells, width, height, childLevel, x + half, y + half);
+  return join(nw, ne, sw, se);
+}
+
+void HashLife::fill(std::vector<World::Cell>& cells,
+                    uint32_t width,
+                    uint32_t height,
+                    uint32_t node,
+                    int64_t x,
+                    int64_t y) {
+  const Node n = nodes[node];
+  const int64_t left = -static_cast<int64_t>(width / 2);
+  const int64_t top = -static_cast<int64_t>(height / 2);
+  const int64_t size = int64_t{1} << n.level;
+  if (n.population == 0 || x + size <= left || y + size <= top ||
+      x >= left + width || y >= top + height) {
+    return;
+  }
+
+  if (n.level == 0) {
+    cells[static_cast<size_t>(y - top) * width + (x - left)].state = 1u;
+    return;
+  }
+
+  const int64_t half = size / 2;
+  fill(cells, width, height, n.nw, x, y);
+  fill(cells, width, height, n.ne, x + half, y);
+  fill(cells, width, height, n.sw, x, y + half);
+  fill(cells, width, height, n.se, x + half, y + half);
+}
+
+void HashLife::reset() {
+  nodes.clear();
+  for (const uint64_t population : {0, 1}) {
+    nodes.push_back({.nw = deadLeaf,
+                     .ne = deadLeaf,
+                     .sw = deadLeaf,
+                     .se = deadLeaf,
+                     .population = population,
+                     .result = deadLeaf,
+                     .level = 0,
+                     .resultStep = noResult});
+  }
+  slots.assign(size_t{1} << 16, emptySlot);
+  emptyNodes.assign(1, deadLeaf);
+  root = getEmpty(3);
+}
+
+// Keeps the nodes reachable from the root and compacts the store. Children
+// are always created before their parents, so a single pass in index order
+// can remap them. Results pointing at collected nodes are forgotten.
+void HashLife::collectGarbage() {
+  const size_t before = nodes.size();
+
+  std::vector<bool> marked(nodes.size(), false);
+  marked[deadLeaf] = true;
+  marked[aliveLeaf] = true;
+  std::vector<uint32_t> stack{root};
+  while (!stack.empty()) {
+    const uint32_t index = stack.back();
+    stack.pop_back();
+    if (marked[index]) {
+      continue;
+    }
+    marked[index] = true;
+    const Node& n = nodes[index];
+    stack.insert(stack.end(), {n.nw, n.ne, n.sw, n.se});
+  }
+
+  std::vector<uint32_t> remap(nodes.size(), emptySlot);
+  std::vector<Node> kept;
+  for (size_t i = 0; i < nodes.size(); i++) {
+    if (!marked[i]) {
+      continue;
+    }
+    Node n = nodes[i];
+    if (n.level > 0) {
+      n.nw = remap[n.nw];
+      n.ne = remap[n.ne];
+      n.sw = remap[n.sw];
+      n.se = remap[n.se];
+    }
+    remap[i] = static_cast<uint32_t>(kept.size());
+    kept.push_back(n);
+  }
+  for (Node& n : kept) {
+    if (n.resultStep != noResult) {
+      n.result = remap[n.result];
+      if (n.result == emptySlot) {
+        n.resultStep = noResult;
+      }
+    }
+  }
+  root = remap[root];
+  nodes = std::move(kept);
+
+  size_t slotCount = size_t{1} << 16;
+  while (nodes.size() * 2 > slotCount) {
+    slotCount *= 2;
+  }
+  rehash(slotCount);
+  emptyNodes.assign(1, deadLeaf);
+
+  statistics.collections++;
+  _log.console("{ HLF }", "collected", before - nodes.size(), "of", before,
+               "nodes");
+}
+
+void HashLife::rehash(size_t slotCount) {
+  slots.assign(slotCount, emptySlot);
+  for (uint32_t i = aliveLeaf + 1; i < nodes.size(); i++) {
+    const Node& n = nodes[i];
+    size_t slot = hashChildren(n.nw, n.ne, n.sw, n.se) & (slotCount - 1);
+    while (slots[slot] != emptySlot) {
+      slot = (slot + 1) & (slotCount - 1);
+    }
+    slots[slot] = i;
+  }
+}
+
+size_t HashLife::hashChildren(uint32_t nw,
+                              uint32_t ne,
+                              uint32_t sw,
+                              uint32_t se) {
+  uint64_t hash = nw;
+  hash = hash * 0x9E3779B97F4A7C15ull + ne;
+  hash = hash * 0x9E3779B97F4A7C15ull + sw;
+  hash = hash * 0x9E3779B97F4A7C15ull + se;
+  return static_cast<size_t>(hash ^ (hash >> 29));
+}
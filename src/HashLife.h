@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "World.h"
+
+// CPU fast forward for Life-like rules using Gosper's HashLife. The grid is a
+// window into an infinite plane stored as a quadtree of hash-consed nodes, so
+// equal regions share one node and the memoised result of a node is reused
+// wherever that region reappears. Unlike the GPU backends the plane does not
+// wrap, cells leaving the window are dropped when the result is extracted.
+class HashLife {
+ public:
+  HashLife();
+  ~HashLife();
+
+  struct Statistics {
+    size_t nodes{0};
+    size_t nodeMemory{0};
+    uint64_t cacheLookups{0};
+    uint64_t cacheHits{0};
+    uint32_t collections{0};
+  } statistics;
+
+ public:
+  void load(const std::vector<World::Cell>& cells,
+            uint32_t width,
+            uint32_t height);
+  void step(uint32_t log2Generations);
+  std::vector<World::Cell> extract(uint32_t width, uint32_t height);
+
+  uint64_t getPopulation() const;
+  void logStatistics();
+
+ private:
+  // Level 0 nodes are the two leaves, a level n node covers 2^n * 2^n cells
+  struct Node {
+    uint32_t nw, ne, sw, se;
+    uint64_t population;
+    uint32_t result;
+    uint8_t level;
+    uint8_t resultStep;
+  };
+
+  inline static const uint32_t deadLeaf{0};
+  inline static const uint32_t aliveLeaf{1};
+  inline static const uint32_t emptySlot{UINT32_MAX};
+  inline static const uint8_t noResult{UINT8_MAX};
+  // Collect garbage before a step once the store grows past this
+  inline static const size_t maxNodes{size_t{1} << 22};
+
+  std::vector<Node> nodes;
+  std::vector<uint32_t> slots;
+  std::vector<uint32_t> emptyNodes;
+  uint32_t root;
+  // Rule the memoised results were computed with
+  uint32_t birth;
+  uint32_t survival;
+
+  uint32_t join(uint32_t nw, uint32_t ne, uint32_t sw, uint32_t se);
+  uint32_t getEmpty(uint8_t level);
+  uint32_t expand(uint32_t node);
+  uint32_t centre(uint32_t node);
+  bool isCentred(uint32_t node);
+
+  uint32_t result(uint32_t node, uint8_t log2Generations);
+  uint32_t resultLevel2(uint32_t node);
+
+  uint32_t build(const std::vector<World::Cell>& cells,
+                 uint32_t width,
+                 uint32_t height,
+                 uint8_t level,
+                 int64_t x,
+                 int64_t y);
+  void fill(std::vector<World::Cell>& cells,
+            uint32_t width,
+            uint32_t height,
+            uint32_t node,
+            int64_t x,
+            int64_t y);
+
+  void reset();
+  void collectGarbage();
+  void rehash(size_t slotCount);
+  size_t hashChildren(uint32_t nw, uint32_t ne, uint32_t sw, uint32_t se);
+};
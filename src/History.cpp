@@ -0,0 +1,72 @@
+#include "CapitalEngine.h"
+#include "History.h"
+
+History::History() : newest{0} {
+  _log.console("{ HIS }", "constructing History");
+}
+
+History::~History() {
+  _log.console("{ HIS }", "destructing History");
+}
+
+bool History::isEnabled() const {
+  return _control.history.length > 0;
+}
+
+uint32_t History::getEntryCount() const {
+  return _control.history.length + _control.history.keyframeCount;
+}
+
+// Same entries as snapshot.comp writes, called as the generation is recorded
+void History::record(uint64_t generation, uint64_t passedHours) {
+  if (generations.empty()) {
+    generations.assign(getEntryCount(), 0);
+    hours.assign(getEntryCount(), 0);
+  }
+  const Control::History& history = _control.history;
+  newest = generation;
+
+  uint32_t entry = static_cast<uint32_t>(generation % history.length);
+  generations[entry] = generation;
+  hours[entry] = passedHours;
+
+  if (generation % history.keyframeInterval == 0) {
+    entry = history.length +
+            static_cast<uint32_t>(generation / history.keyframeInterval %
+                                  history.keyframeCount);
+    generations[entry] = generation;
+    hours[entry] = passedHours;
+  }
+}
+
+// The generation itself while it is among the last ones, otherwise the
+// keyframe at or before it. Generation 0 is never computed, so never kept.
+std::optional<History::Snapshot> History::find(uint64_t generation) const {
+  if (generations.empty() || generation == 0 || generation > newest) {
+    return std::nullopt;
+  }
+  const Control::History& history = _control.history;
+
+  const std::optional<Snapshot> recent = getEntry(
+      static_cast<uint32_t>(generation % history.length), generation);
+  if (recent) {
+    return recent;
+  }
+
+  const uint64_t keyframe =
+      generation / history.keyframeInterval * history.keyframeInterval;
+  return getEntry(history.length +
+                      static_cast<uint32_t>(keyframe /
+                                            history.keyframeInterval %
+                                            history.keyframeCount),
+                  keyframe);
+}
+
+std::optional<History::Snapshot> History::getEntry(uint32_t entry,
+                                                   uint64_t generation) const {
+  if (generation == 0 || generations[entry] != generation) {
+    return std::nullopt;
+  }
+  return Snapshot{
+      .entry = entry, .generation = generation, .passedHours = hours[entry]};
+}
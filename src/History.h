@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+// Host side of the generation history snapshot.comp fills on the device.
+// Generation g is kept in entry g % history.length, every keyframeInterval-th
+// generation also in keyframe entry length + g / keyframeInterval %
+// keyframeCount, which reach further back at a coarser spacing. A snapshot
+// holds the alive and stage bits of every cell, the rest of a cell's state
+// follows from the hour the generation was computed in, which is kept here.
+class History {
+ public:
+  History();
+  ~History();
+
+  struct Snapshot {
+    uint32_t entry{0};
+    uint64_t generation{0};
+    uint64_t passedHours{0};
+  };
+
+ public:
+  bool isEnabled() const;
+  uint32_t getEntryCount() const;
+  void record(uint64_t generation, uint64_t passedHours);
+  std::optional<Snapshot> find(uint64_t generation) const;
+
+ private:
+  // Generation and hour each entry was last written with
+  std::vector<uint64_t> generations;
+  std::vector<uint64_t> hours;
+  // Entries past the newest recorded generation belong to a timeline that was
+  // rewound and are never found
+  uint64_t newest;
+
+  std::optional<Snapshot> getEntry(uint32_t entry, uint64_t generation) const;
+};
@@ -0,0 +1,123 @@
+#include <stdexcept>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "CapitalEngine.h"
+#include "MappedFile.h"
+
+MappedFile::~MappedFile() {
+  close(size);
+}
+
+void MappedFile::openForReading(const std::string& path) {
+  writable = false;
+#ifdef _WIN32
+  file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                     OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  LARGE_INTEGER fileSize{};
+  if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &fileSize) ||
+      fileSize.QuadPart == 0) {
+    throw std::runtime_error("\n!ERROR! failed to open file: " + path);
+  }
+  size = static_cast<uint64_t>(fileSize.QuadPart);
+  mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (mapping != nullptr) {
+    data = static_cast<uint8_t*>(
+        MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+  }
+#else
+  descriptor = ::open(path.c_str(), O_RDONLY);
+  struct stat status {};
+  if (descriptor < 0 || fstat(descriptor, &status) != 0 ||
+      status.st_size == 0) {
+    throw std::runtime_error("\n!ERROR! failed to open file: " + path);
+  }
+  size = static_cast<uint64_t>(status.st_size);
+  void* view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+  if (view != MAP_FAILED) {
+    // Files are read front to back
+    madvise(view, size, MADV_SEQUENTIAL);
+    data = static_cast<uint8_t*>(view);
+  }
+#endif
+  if (data == nullptr) {
+    throw std::runtime_error("\n!ERROR! failed to map file: " + path);
+  }
+}
+
+void MappedFile::create(const std::string& path, uint64_t capacity) {
+  writable = true;
+  size = capacity;
+#ifdef _WIN32
+  file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr,
+                     CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    throw std::runtime_error("\n!ERROR! failed to create file: " + path);
+  }
+  mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE,
+                               static_cast<DWORD>(capacity >> 32),
+                               static_cast<DWORD>(capacity), nullptr);
+  if (mapping != nullptr) {
+    data = static_cast<uint8_t*>(
+        MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, 0));
+  }
+#else
+  descriptor = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (descriptor < 0 ||
+      ftruncate(descriptor, static_cast<off_t>(capacity)) != 0) {
+    throw std::runtime_error("\n!ERROR! failed to create file: " + path);
+  }
+  void* view = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED,
+                    descriptor, 0);
+  if (view != MAP_FAILED) {
+    data = static_cast<uint8_t*>(view);
+  }
+#endif
+  if (data == nullptr) {
+    throw std::runtime_error("\n!ERROR! failed to map file: " + path);
+  }
+}
+
+// A written file is cut to finalSize
+void MappedFile::close(uint64_t finalSize) {
+#ifdef _WIN32
+  if (data != nullptr) {
+    UnmapViewOfFile(data);
+  }
+  if (mapping != nullptr) {
+    CloseHandle(mapping);
+  }
+  if (file != nullptr && file != INVALID_HANDLE_VALUE) {
+    if (writable) {
+      LARGE_INTEGER end{};
+      end.QuadPart = static_cast<LONGLONG>(finalSize);
+      SetFilePointerEx(file, end, nullptr, FILE_BEGIN);
+      SetEndOfFile(file);
+    }
+    CloseHandle(file);
+  }
+  file = nullptr;
+  mapping = nullptr;
+#else
+  if (data != nullptr) {
+    munmap(data, size);
+  }
+  if (descriptor >= 0) {
+    if (writable && ftruncate(descriptor, static_cast<off_t>(finalSize)) != 0) {
+      _log.console("{ MAP }", "failed to truncate file");
+    }
+    ::close(descriptor);
+  }
+  descriptor = -1;
+#endif
+  data = nullptr;
+  size = 0;
+}
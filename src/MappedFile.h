@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// A whole file mapped for reading, or created at a size for writing and cut
+// to the size written when closed
+class MappedFile {
+ public:
+  MappedFile() = default;
+  ~MappedFile();
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  uint8_t* data{nullptr};
+  uint64_t size{0};
+
+  void openForReading(const std::string& path);
+  void create(const std::string& path, uint64_t capacity);
+  void close(uint64_t finalSize);
+
+ private:
+  bool writable{false};
+#ifdef _WIN32
+  void* file{nullptr};
+  void* mapping{nullptr};
+#else
+  int descriptor{-1};
+#endif
+};
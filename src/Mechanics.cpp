@@ -3,6 +3,7 @@
 #include "vulkan/vulkan.h"
 
 #include <algorithm>
+#include <array>
 #include <set>
 #include <stdexcept>
 
@@ -19,6 +20,7 @@ VulkanMechanics::VulkanMechanics()
       instance(VK_NULL_HANDLE),
       mainDevice{VK_NULL_HANDLE, VK_NULL_HANDLE},
       queues{VK_NULL_HANDLE,
+             VK_NULL_HANDLE,
              VK_NULL_HANDLE,
              VK_NULL_HANDLE,
              {std::nullopt, std::nullopt}},
@@ -73,7 +75,8 @@ void VulkanMechanics::createInstance() {
     createInfo.pNext = &debugCreateInfo;
   }
 
-  _mechanics.result(vkCreateInstance, &createInfo, nullptr, &instance);
+  _mechanics.result(vkCreateInstance, &createInfo, _telemetry.getCallbacks(),
+                    &instance);
 }
 
 void VulkanMechanics::createSurface() {
@@ -123,6 +126,16 @@ VulkanMechanics::Queues::FamilyIndices VulkanMechanics::findQueueFamilies(
 
   size_t i = 0;
   for (const auto& queueFamily : queueFamilies) {
+    // Headless runs only dispatch compute work, any compute family will do
+    if (_control.simulation.headless) {
+      if (queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT) {
+        indices.graphicsAndComputeFamily = i;
+        break;
+      }
+      i++;
+      continue;
+    }
+
     if ((queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) &&
         (queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT)) {
       indices.graphicsAndComputeFamily = i;
@@ -143,6 +156,25 @@ VulkanMechanics::Queues::FamilyIndices VulkanMechanics::findQueueFamilies(
     i++;
   }
 
+  indices.computeFamily = indices.graphicsAndComputeFamily;
+  for (uint32_t family = 0; family < queueFamilyCount; family++) {
+    const VkQueueFlags flags = queueFamilies[family].queueFlags;
+    if ((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT)) {
+      indices.computeFamily = family;
+      break;
+    }
+  }
+
+  indices.transferFamily = indices.graphicsAndComputeFamily;
+  for (uint32_t family = 0; family < queueFamilyCount; family++) {
+    const VkQueueFlags flags = queueFamilies[family].queueFlags;
+    if ((flags & VK_QUEUE_TRANSFER_BIT) &&
+        !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+      indices.transferFamily = family;
+      break;
+    }
+  }
+
   return indices;
 }
 
@@ -205,9 +237,15 @@ void VulkanMechanics::createLogicalDevice() {
   _log.console("{ +++ }", "creating Logical Device");
   Queues::FamilyIndices indices = findQueueFamilies(mainDevice.physical);
 
+  const bool headless = _control.simulation.headless;
+
   std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
   std::set<uint32_t> uniqueQueueFamilies = {
-      indices.graphicsAndComputeFamily.value(), indices.presentFamily.value()};
+      indices.graphicsAndComputeFamily.value(), indices.computeFamily.value(),
+      indices.transferFamily.value()};
+  if (!headless) {
+    uniqueQueueFamilies.insert(indices.presentFamily.value());
+  }
 
   float queuePriority = 1.0f;
   for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -224,15 +262,36 @@ void VulkanMechanics::createLogicalDevice() {
                                           .depthClamp = VK_TRUE,
                                           .depthBiasClamp = VK_TRUE,
                                           .shaderInt64 = VK_TRUE};
+  if (headless) {
+    deviceFeatures = {.shaderInt64 = VK_TRUE};
+  }
+  // Optional, the profiler reads shader invocations when available
+  VkPhysicalDeviceFeatures supportedFeatures;
+  vkGetPhysicalDeviceFeatures(mainDevice.physical, &supportedFeatures);
+  deviceFeatures.pipelineStatisticsQuery =
+      supportedFeatures.pipelineStatisticsQuery;
+
+  VkPhysicalDeviceVulkan12Features vulkan12Features{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+      .timelineSemaphore = VK_TRUE};
+
+  // Optional, see MemoryTelemetry
+  std::vector<const char*> extensions;
+  if (!headless) {
+    extensions = mainDevice.extensions;
+  }
+  if (_telemetry.checkBudgetSupport(mainDevice.physical)) {
+    extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+  }
 
   VkDeviceCreateInfo createInfo{
       .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+      .pNext = &vulkan12Features,
       .queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size()),
       .pQueueCreateInfos = queueCreateInfos.data(),
       .enabledLayerCount = 0,
-      .enabledExtensionCount =
-          static_cast<uint32_t>(mainDevice.extensions.size()),
-      .ppEnabledExtensionNames = mainDevice.extensions.data(),
+      .enabledExtensionCount = static_cast<uint32_t>(extensions.size()),
+      .ppEnabledExtensionNames = extensions.data(),
       .pEnabledFeatures = &deviceFeatures};
 
   if (_validation.enableValidationLayers) {
@@ -241,15 +300,28 @@ void VulkanMechanics::createLogicalDevice() {
     createInfo.ppEnabledLayerNames = _validation.validation.data();
   }
 
-  _mechanics.result(vkCreateDevice, mainDevice.physical, &createInfo, nullptr,
-                    &mainDevice.logical);
+  _mechanics.result(vkCreateDevice, mainDevice.physical, &createInfo,
+                    _telemetry.getCallbacks(), &mainDevice.logical);
 
   vkGetDeviceQueue(mainDevice.logical, indices.graphicsAndComputeFamily.value(),
                    0, &queues.graphics);
-  vkGetDeviceQueue(mainDevice.logical, indices.graphicsAndComputeFamily.value(),
-                   0, &queues.compute);
-  vkGetDeviceQueue(mainDevice.logical, indices.presentFamily.value(), 0,
-                   &queues.present);
+  vkGetDeviceQueue(mainDevice.logical, indices.computeFamily.value(), 0,
+                   &queues.compute);
+  vkGetDeviceQueue(mainDevice.logical, indices.transferFamily.value(), 0,
+                   &queues.transfer);
+  queues.familyIndices = indices;
+  if (indices.hasAsyncCompute()) {
+    _log.console(_log.style.charLeader, "simulating on compute only family",
+                 indices.computeFamily.value());
+  }
+  if (indices.hasTransferQueue()) {
+    _log.console(_log.style.charLeader, "uploading on transfer only family",
+                 indices.transferFamily.value());
+  }
+  if (!headless) {
+    vkGetDeviceQueue(mainDevice.logical, indices.presentFamily.value(), 0,
+                     &queues.present);
+  }
 }
 
 VkSurfaceFormatKHR VulkanMechanics::chooseSwapSurfaceFormat(
@@ -305,16 +377,12 @@ void VulkanMechanics::createSyncObjects() {
 
   syncObjects.imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
   syncObjects.renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-  syncObjects.computeFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-  syncObjects.inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-  syncObjects.computeInFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+  syncObjects.computeValues.assign(MAX_FRAMES_IN_FLIGHT, 0);
+  syncObjects.frameValues.assign(MAX_FRAMES_IN_FLIGHT, 0);
 
   VkSemaphoreCreateInfo semaphoreInfo{
       .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
 
-  VkFenceCreateInfo fenceInfo{.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
-                              .flags = VK_FENCE_CREATE_SIGNALED_BIT};
-
   for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
     _mechanics.result(vkCreateSemaphore, _mechanics.mainDevice.logical,
                       &semaphoreInfo, nullptr,
@@ -323,17 +391,84 @@ void VulkanMechanics::createSyncObjects() {
     _mechanics.result(vkCreateSemaphore, _mechanics.mainDevice.logical,
                       &semaphoreInfo, nullptr,
                       &syncObjects.renderFinishedSemaphores[i]);
+  }
 
-    _mechanics.result(vkCreateFence, _mechanics.mainDevice.logical, &fenceInfo,
-                      nullptr, &syncObjects.inFlightFences[i]);
+  // The simulation timeline starts at the generation the grid is loaded at
+  VkSemaphoreTypeCreateInfo timelineTypeInfo{
+      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+      .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+      .initialValue = _control.simulation.generation};
+  VkSemaphoreCreateInfo timelineInfo{
+      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+      .pNext = &timelineTypeInfo};
+
+  _mechanics.result(vkCreateSemaphore, _mechanics.mainDevice.logical,
+                    &timelineInfo, nullptr, &syncObjects.simulationTimeline);
+
+  timelineTypeInfo.initialValue = 0;
+  _mechanics.result(vkCreateSemaphore, _mechanics.mainDevice.logical,
+                    &timelineInfo, nullptr, &syncObjects.frameTimeline);
+}
 
-    _mechanics.result(vkCreateSemaphore, _mechanics.mainDevice.logical,
-                      &semaphoreInfo, nullptr,
-                      &syncObjects.computeFinishedSemaphores[i]);
+// Blocks until the submissions that last used the frame's command buffers,
+// uniforms and queries are done, later ones keep running
+void VulkanMechanics::waitForFrame(uint32_t frame) {
+  std::array<VkSemaphore, 2> semaphores{syncObjects.simulationTimeline,
+                                        syncObjects.frameTimeline};
+  std::array<uint64_t, 2> values{syncObjects.computeValues[frame],
+                                 syncObjects.frameValues[frame]};
+  VkSemaphoreWaitInfo waitInfo{
+      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+      .semaphoreCount = static_cast<uint32_t>(semaphores.size()),
+      .pSemaphores = semaphores.data(),
+      .pValues = values.data()};
+  _mechanics.result(vkWaitSemaphores, mainDevice.logical, &waitInfo,
+                    UINT64_MAX);
+}
 
-    _mechanics.result(vkCreateFence, _mechanics.mainDevice.logical, &fenceInfo,
-                      nullptr, &syncObjects.computeInFlightFences[i]);
-  }
+// Blocks until the grid has reached at least the generation on the device,
+// for anything that reads results back
+void VulkanMechanics::waitForGeneration(uint64_t generation) {
+  const uint64_t value = getTimelineValue(generation);
+  VkSemaphoreWaitInfo waitInfo{
+      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+      .semaphoreCount = 1,
+      .pSemaphores = &syncObjects.simulationTimeline,
+      .pValues = &value};
+  _mechanics.result(vkWaitSemaphores, mainDevice.logical, &waitInfo,
+                    UINT64_MAX);
+}
+
+// For generations advanced on the host, the timeline must not fall behind
+// simulation.generation
+void VulkanMechanics::signalGeneration(uint64_t generation) {
+  VkSemaphoreSignalInfo signalInfo{
+      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SIGNAL_INFO,
+      .semaphore = syncObjects.simulationTimeline,
+      .value = getTimelineValue(generation)};
+  _mechanics.result(vkSignalSemaphore, mainDevice.logical, &signalInfo);
+}
+
+// Uploads and one-time commands from now on wait on the device for every
+// generation and frame submitted so far, before they overwrite what those
+// may still read
+void VulkanMechanics::orderUploadsAfterSubmissions() {
+  _uploader.waitFor(syncObjects.simulationTimeline,
+                    getTimelineValue(_control.simulation.generation));
+  _uploader.waitFor(syncObjects.frameTimeline, syncObjects.frameValue);
+}
+
+uint64_t VulkanMechanics::getTimelineValue(uint64_t generation) const {
+  return generation + syncObjects.timelineOffset;
+}
+
+// A timeline only counts up. Before simulation.generation is set to a restored
+// generation, that generation is mapped to the value the timeline is at, so
+// the generations from it on signal new values. The timeline is at least at
+// any generation computed so far, so the offset never turns negative.
+void VulkanMechanics::continueTimelineAt(uint64_t generation) {
+  syncObjects.timelineOffset =
+      getTimelineValue(_control.simulation.generation) - generation;
 }
 
 void VulkanMechanics::cleanupSwapChain() {
@@ -341,15 +476,13 @@ void VulkanMechanics::cleanupSwapChain() {
                      _pipelines.graphics.depth.imageView, nullptr);
   vkDestroyImage(_mechanics.mainDevice.logical, _pipelines.graphics.depth.image,
                  nullptr);
-  vkFreeMemory(_mechanics.mainDevice.logical,
-               _pipelines.graphics.depth.imageMemory, nullptr);
+  _allocator.free(_pipelines.graphics.depth.imageMemory);
 
   vkDestroyImageView(_mechanics.mainDevice.logical,
                      _pipelines.graphics.msaa.colorImageView, nullptr);
   vkDestroyImage(_mechanics.mainDevice.logical,
                  _pipelines.graphics.msaa.colorImage, nullptr);
-  vkFreeMemory(_mechanics.mainDevice.logical,
-               _pipelines.graphics.msaa.colorImageMemory, nullptr);
+  _allocator.free(_pipelines.graphics.msaa.colorImageMemory);
 
   for (auto framebuffer : swapChain.framebuffers) {
     vkDestroyFramebuffer(_mechanics.mainDevice.logical, framebuffer, nullptr);
@@ -367,7 +500,37 @@ bool VulkanMechanics::isDeviceSuitable(VkPhysicalDevice physicalDevice) {
   _log.console(_log.style.charLeader,
                "checking if Physical Device is suitable");
 
+  // Frames and generations are synchronised with timeline semaphores
+  VkPhysicalDeviceVulkan12Features vulkan12Features{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+  VkPhysicalDeviceFeatures2 features{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+      .pNext = &vulkan12Features};
+  vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+  if (!vulkan12Features.timelineSemaphore) {
+    return false;
+  }
+
+  // Statistics are reduced with subgroup arithmetic in the compute shader
+  if (_control.statistics.enabled) {
+    VkPhysicalDeviceSubgroupProperties subgroupProperties{
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES};
+    VkPhysicalDeviceProperties2 properties{
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+        .pNext = &subgroupProperties};
+    vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+    const VkSubgroupFeatureFlags operations =
+        VK_SUBGROUP_FEATURE_BASIC_BIT | VK_SUBGROUP_FEATURE_ARITHMETIC_BIT;
+    if (!(subgroupProperties.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) ||
+        (subgroupProperties.supportedOperations & operations) != operations) {
+      return false;
+    }
+  }
+
   Queues::FamilyIndices indices = findQueueFamilies(physicalDevice);
+  if (_control.simulation.headless) {
+    return indices.graphicsAndComputeFamily.has_value();
+  }
 
   bool extensionsSupported = checkDeviceExtensionSupport(physicalDevice);
 
@@ -456,15 +619,19 @@ void VulkanMechanics::recreateSwapChain() {
   _pipelines.createDepthResources();
   _pipelines.createColorResources();
   _memory.createFramebuffers();
+  if (_control.simulation.prerecorded) {
+    _memory.createPrerecordedCommandBuffers();
+  }
 }
 
 std::vector<const char*> VulkanMechanics::getRequiredExtensions() {
-  uint32_t glfwExtensionCount = 0;
-  const char** glfwExtensions;
-  glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-
-  std::vector<const char*> extensions(glfwExtensions,
-                                      glfwExtensions + glfwExtensionCount);
+  std::vector<const char*> extensions;
+  if (!_control.simulation.headless) {
+    uint32_t glfwExtensionCount = 0;
+    const char** glfwExtensions;
+    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+  }
 
   if (_validation.enableValidationLayers) {
     extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -28,14 +28,27 @@ class VulkanMechanics {
     VkQueue graphics;
     VkQueue compute;
     VkQueue present;
+    VkQueue transfer;
 
     struct FamilyIndices {
       std::optional<uint32_t> graphicsAndComputeFamily;
       std::optional<uint32_t> presentFamily;
+      // A compute only family when the device has one so simulation runs
+      // alongside rendering, else graphicsAndComputeFamily
+      std::optional<uint32_t> computeFamily;
+      // A transfer only family when the device has one so uploads run
+      // alongside both, else graphicsAndComputeFamily, see Uploader
+      std::optional<uint32_t> transferFamily;
       bool isComplete() const {
         return graphicsAndComputeFamily.has_value() &&
                presentFamily.has_value();
       }
+      bool hasAsyncCompute() const {
+        return computeFamily != graphicsAndComputeFamily;
+      }
+      bool hasTransferQueue() const {
+        return transferFamily != graphicsAndComputeFamily;
+      }
     } familyIndices;
   } queues;
 
@@ -54,12 +67,20 @@ class VulkanMechanics {
     } supportDetails;
   } swapChain;
 
+  // Binary semaphores only where the swap chain needs them. The simulation
+  // timeline counts generations, a compute submission signals the generation
+  // it leaves the grid at plus timelineOffset, which grows whenever an earlier
+  // generation is restored; the frame timeline counts submitted frames. Each
+  // frame in flight keeps the values its last submissions signal.
   struct SynchronizationObjects {
     std::vector<VkSemaphore> imageAvailableSemaphores;
     std::vector<VkSemaphore> renderFinishedSemaphores;
-    std::vector<VkSemaphore> computeFinishedSemaphores;
-    std::vector<VkFence> inFlightFences;
-    std::vector<VkFence> computeInFlightFences;
+    VkSemaphore simulationTimeline;
+    VkSemaphore frameTimeline;
+    uint64_t frameValue{0};
+    uint64_t timelineOffset{0};
+    std::vector<uint64_t> computeValues;
+    std::vector<uint64_t> frameValues;
     uint32_t currentFrame = 0;
   } syncObjects;
 
@@ -80,6 +101,12 @@ class VulkanMechanics {
                               VkImageAspectFlags aspectFlags);
 
   void createSyncObjects();
+  void waitForFrame(uint32_t frame);
+  void waitForGeneration(uint64_t generation);
+  void signalGeneration(uint64_t generation);
+  void orderUploadsAfterSubmissions();
+  uint64_t getTimelineValue(uint64_t generation) const;
+  void continueTimelineAt(uint64_t generation);
 
   Queues::FamilyIndices findQueueFamilies(VkPhysicalDevice physicalDevice);
 
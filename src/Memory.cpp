@@ -2,6 +2,10 @@
 #include "CapitalEngine.h"
 #include "Debug.h"
 #include "Pipelines.h"
+#include "Random.h"
+
+#include <algorithm>
+#include <cstring>
 
 Memory::Memory() : pushConstants{}, buffers{}, descriptor{} {
   _log.console("{ 010 }", "constructing Memory Management");
@@ -41,8 +45,8 @@ void Memory::createFramebuffers() {
 void Memory::createCommandPool() {
   _log.console("{ CMD }", "creating Command Pool");
 
-  VulkanMechanics::Queues::FamilyIndices queueFamilyIndices =
-      _mechanics.findQueueFamilies(_mechanics.mainDevice.physical);
+  const VulkanMechanics::Queues::FamilyIndices& queueFamilyIndices =
+      _mechanics.queues.familyIndices;
 
   VkCommandPoolCreateInfo poolInfo{
       .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
@@ -51,6 +55,10 @@ void Memory::createCommandPool() {
 
   _mechanics.result(vkCreateCommandPool, _mechanics.mainDevice.logical,
                     &poolInfo, nullptr, &buffers.command.pool);
+
+  poolInfo.queueFamilyIndex = queueFamilyIndices.computeFamily.value();
+  _mechanics.result(vkCreateCommandPool, _mechanics.mainDevice.logical,
+                    &poolInfo, nullptr, &buffers.command.computePool);
 }
 
 void Memory::createCommandBuffers() {
@@ -77,7 +85,7 @@ void Memory::createComputeCommandBuffers() {
 
   VkCommandBufferAllocateInfo allocateInfo{
       .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-      .commandPool = buffers.command.pool,
+      .commandPool = buffers.command.computePool,
       .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
       .commandBufferCount =
           static_cast<uint32_t>(buffers.command.compute.size())};
@@ -86,44 +94,535 @@ void Memory::createComputeCommandBuffers() {
                     &allocateInfo, buffers.command.compute.data());
 }
 
+// Every command buffer a steady-state frame submits, recorded once: a compute
+// buffer per frame in flight, first ring slot and generation count up to
+// ringSize - 1, and a graphics buffer per frame in flight, swap chain image and
+// ring slot drawn. Frames then only fill the parameter buffer. Recorded again
+// whenever the swap chain or the rule changes.
+void Memory::createPrerecordedCommandBuffers() {
+  _log.console("{ CMD }", "recording Prerecorded Command Buffers");
+
+  std::vector<VkCommandBuffer>& compute = buffers.command.prerecordedCompute;
+  std::vector<VkCommandBuffer>& graphic = buffers.command.prerecordedGraphic;
+  if (!compute.empty()) {
+    vkFreeCommandBuffers(_mechanics.mainDevice.logical,
+                         buffers.command.computePool,
+                         static_cast<uint32_t>(compute.size()), compute.data());
+    vkFreeCommandBuffers(_mechanics.mainDevice.logical, buffers.command.pool,
+                         static_cast<uint32_t>(graphic.size()), graphic.data());
+  }
+
+  const uint32_t ringSize = _control.timer.ringSize;
+  const uint32_t imageCount =
+      static_cast<uint32_t>(_mechanics.swapChain.framebuffers.size());
+  compute.resize(MAX_FRAMES_IN_FLIGHT * ringSize * (ringSize - 1));
+  graphic.resize(MAX_FRAMES_IN_FLIGHT * imageCount * ringSize);
+
+  VkCommandBufferAllocateInfo allocateInfo{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+      .commandPool = buffers.command.computePool,
+      .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+      .commandBufferCount = static_cast<uint32_t>(compute.size())};
+  _mechanics.result(vkAllocateCommandBuffers, _mechanics.mainDevice.logical,
+                    &allocateInfo, compute.data());
+
+  allocateInfo.commandPool = buffers.command.pool;
+  allocateInfo.commandBufferCount = static_cast<uint32_t>(graphic.size());
+  _mechanics.result(vkAllocateCommandBuffers, _mechanics.mainDevice.logical,
+                    &allocateInfo, graphic.data());
+
+  // Descriptor sets and query pools belong to the frame being recorded
+  uint32_t& currentFrame = _mechanics.syncObjects.currentFrame;
+  const uint32_t frame = currentFrame;
+
+  VkCommandBufferBeginInfo beginInfo{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+  for (currentFrame = 0; currentFrame < MAX_FRAMES_IN_FLIGHT; currentFrame++) {
+    for (uint32_t slot = 0; slot < ringSize; slot++) {
+      for (uint32_t generations = 1; generations < ringSize; generations++) {
+        VkCommandBuffer commandBuffer =
+            compute[(currentFrame * ringSize + slot) * (ringSize - 1) +
+                    generations - 1];
+        _mechanics.result(vkBeginCommandBuffer, commandBuffer, &beginInfo);
+        _profiler.beginPass(commandBuffer, Profiler::Pass::compute);
+        recordGenerations(commandBuffer, slot, generations);
+        _profiler.endPass(commandBuffer, Profiler::Pass::compute);
+        _mechanics.result(vkEndCommandBuffer, commandBuffer);
+      }
+    }
+    for (uint32_t image = 0; image < imageCount; image++) {
+      for (uint32_t slot = 0; slot < ringSize; slot++) {
+        recordCommandBuffer(
+            graphic[(currentFrame * imageCount + image) * ringSize + slot],
+            image, slot);
+      }
+    }
+  }
+  currentFrame = frame;
+
+  _log.console(_log.style.charLeader, compute.size(), "compute and",
+               graphic.size(), "graphics command buffers");
+}
+
+// Draws the latest generation in the ring
+VkCommandBuffer& Memory::getPrerecordedGraphic(uint32_t imageIndex) {
+  const uint32_t ringSize = _control.timer.ringSize;
+  const uint32_t imageCount =
+      static_cast<uint32_t>(_mechanics.swapChain.framebuffers.size());
+  return buffers.command.prerecordedGraphic
+      [(_mechanics.syncObjects.currentFrame * imageCount + imageIndex) *
+           ringSize +
+       _scheduler.getLatestSlot()];
+}
+
+// Computes the generations after the latest one in the ring, taken before
+// advanceGenerations moves the ring on
+VkCommandBuffer& Memory::getPrerecordedCompute(uint32_t generations) {
+  const uint32_t ringSize = _control.timer.ringSize;
+  const uint32_t firstSlot = (_scheduler.getLatestSlot() + 1) % ringSize;
+  return buffers.command.prerecordedCompute
+      [(_mechanics.syncObjects.currentFrame * ringSize + firstSlot) *
+           (ringSize - 1) +
+       generations - 1];
+}
+
 void Memory::createShaderStorageBuffers() {
   _log.console("{ BUF }", "creating Shader Storage Buffers");
 
-  std::vector<World::Cell> cells = _world.initializeCells();
+  // The per-cell backend streams a checkpoint straight into the ring, the
+  // others keep a host copy of the cells anyway. Patterns are streamed into
+  // the packed grid, which expandPattern unpacks into the ring once the
+  // descriptor sets exist, unless the CPU backend keeps the cells.
+  const bool streamCheckpoint =
+      _checkpoint.isOpen() &&
+      _control.simulation.backend == Control::Simulation::Backend::cells;
+  const bool streamPattern =
+      _pattern.isOpen() &&
+      _control.simulation.backend != Control::Simulation::Backend::cpu;
+  std::vector<World::Cell> cells;
+  if (!streamCheckpoint && !streamPattern && !isSeededOnDevice()) {
+    cells = _world.initializeCells();
+  }
 
   VkDeviceSize bufferSize = sizeof(World::Cell) * _control.grid.dimensions[0] *
                             _control.grid.dimensions[1];
 
-  // Create a staging buffer used to upload data to the gpu
-  VkBuffer stagingBuffer;
-  VkDeviceMemory stagingBufferMemory;
-  createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+  buffers.shaderStorage.resize(_control.timer.ringSize);
+  buffers.shaderStorageMemory.resize(_control.timer.ringSize);
+
+  for (size_t i = 0; i < _control.timer.ringSize; i++) {
+    createSharedBuffer(static_cast<VkDeviceSize>(bufferSize),
+                       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                           VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+                           VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+                           VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                       buffers.shaderStorage[i],
+                       buffers.shaderStorageMemory[i]);
+  }
+
+  if (streamCheckpoint) {
+    uploadCheckpoint();
+  } else if (!cells.empty()) {
+    // Copy initial Cell data to all storage buffers
+    _uploader.upload(cells.data(), bufferSize, buffers.shaderStorage);
+  }
+
+  createPackedStorageBuffer(cells);
+  createNeighbourSumBuffer();
+  createHistoryBuffer();
+  createRecordingBuffers();
+  createParameterBuffers();
+  createStatisticsBuffers();
+  if (_control.simulation.backend == Control::Simulation::Backend::cpu) {
+    createCpuStagingBuffers(cells);
+  }
+}
+
+// Chunks are decoded from the mapped checkpoint straight into the upload
+// ring, a batch at a time, and copied into every slot of the ring of
+// generations. No host copy of the grid is made.
+void Memory::uploadCheckpoint() {
+  const VkDeviceSize chunkSize = sizeof(World::Cell) * Checkpoint::chunkRows *
+                                 _control.grid.dimensions[0];
+  const VkDeviceSize gridSize = sizeof(World::Cell) *
+                                _control.grid.dimensions[0] *
+                                _control.grid.dimensions[1];
+  const uint32_t chunksPerBatch = static_cast<uint32_t>(
+      std::max<VkDeviceSize>(Uploader::batchSize / chunkSize, 1));
+
+  const uint32_t chunkCount = _checkpoint.getChunkCount();
+  for (uint32_t first = 0; first < chunkCount; first += chunksPerBatch) {
+    const uint32_t last = std::min(first + chunksPerBatch, chunkCount);
+    const VkDeviceSize offset = chunkSize * first;
+    const Uploader::Staging staging = _uploader.stage(
+        std::min(chunkSize * (last - first), gridSize - offset));
+    World::Cell* cells = static_cast<World::Cell*>(staging.data);
+    for (uint32_t chunk = first; chunk < last; chunk++) {
+      _checkpoint.decodeChunk(
+          chunk, cells + static_cast<size_t>(chunk - first) *
+                             Checkpoint::chunkRows *
+                             _control.grid.dimensions[0]);
+    }
+    for (size_t i = 0; i < buffers.shaderStorage.size(); i++) {
+      _uploader.copyStaged(staging, buffers.shaderStorage[i], offset);
+    }
+  }
+}
+
+// Both generations of the packed grid start from the same cells as the
+// per-cell backend, or from the pattern being streamed in
+void Memory::createPackedStorageBuffer(const std::vector<World::Cell>& cells) {
+  _log.console("{ BUF }", "creating Packed Storage Buffer");
+
+  // Without host cells the grid is seeded, expanded from a pattern or
+  // streamed on the device, which starts from a grid cleared in place
+  if (cells.empty()) {
+    const VkDeviceSize bufferSize =
+        sizeof(uint32_t) * 2 * ((_control.grid.dimensions[0] + 31) / 32) *
+        _control.grid.dimensions[1];
+    createSharedBuffer(bufferSize,
+                       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                           VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffers.packed,
+                       buffers.packedMemory);
+    if (_pattern.isOpen()) {
+      uploadPattern();
+    } else {
+      _uploader.fill(buffers.packed, 0);
+    }
+    createActivityBuffer();
+    return;
+  }
+
+  std::vector<uint32_t> words = packCells(cells);
+
+  VkDeviceSize bufferSize = sizeof(uint32_t) * words.size();
+
+  createSharedBuffer(bufferSize,
+                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                         VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffers.packed,
+                     buffers.packedMemory);
+  _uploader.upload(words.data(), bufferSize, {buffers.packed});
+
+  createActivityBuffer();
+}
+
+// Bands of rows are decoded from the mapped pattern straight into the upload
+// ring and copied into both generations of the packed grid. Neither the file
+// nor the grid is ever held as cells.
+void Memory::uploadPattern() {
+  const uint32_t height = static_cast<uint32_t>(_control.grid.dimensions[1]);
+  const VkDeviceSize rowSize =
+      sizeof(uint32_t) * ((_control.grid.dimensions[0] + 31) / 32);
+  const VkDeviceSize generationSize = rowSize * height;
+  const uint32_t rowsPerBand = static_cast<uint32_t>(
+      std::clamp<VkDeviceSize>(Uploader::batchSize / rowSize, 1, height));
+
+  for (uint32_t first = 0; first < height; first += rowsPerBand) {
+    const uint32_t rows = std::min(rowsPerBand, height - first);
+    const Uploader::Staging staging = _uploader.stage(rowSize * rows);
+    std::memset(staging.data, 0, staging.size);
+    _pattern.decodeRows(first, rows, static_cast<uint32_t*>(staging.data));
+    _uploader.copyStaged(staging, buffers.packed, rowSize * first);
+    _uploader.copyStaged(staging, buffers.packed,
+                         generationSize + rowSize * first);
+  }
+}
+
+void Memory::createActivityBuffer() {
+  _log.console("{ BUF }", "creating Activity Buffer");
+
+  std::vector<uint32_t> activity = getInitialActivity();
+
+  VkDeviceSize bufferSize = sizeof(uint32_t) * activity.size();
+
+  createSharedBuffer(bufferSize,
+                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                         VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                         VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffers.activity,
+                     buffers.activityMemory);
+  _uploader.upload(activity.data(), bufferSize, {buffers.activity});
+}
+
+// A single word when no rule needs it, binding 5 still wants a buffer
+void Memory::createNeighbourSumBuffer() {
+  _log.console("{ BUF }", "creating Neighbour Sum Buffer");
+
+  const VkDeviceSize cellCount =
+      static_cast<VkDeviceSize>(_control.grid.dimensions[0]) *
+      _control.grid.dimensions[1];
+  const VkDeviceSize bufferSize =
+      sizeof(uint32_t) * (_control.hasLargerThanLifeRule() ? 2 * cellCount : 1);
+
+  createBuffer(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffers.neighbourSums,
+               buffers.neighbourSumsMemory);
+}
+
+// Two bits per cell and history entry, see snapshot.comp. A single word
+// without a history, binding 7 still wants a buffer.
+void Memory::createHistoryBuffer() {
+  _log.console("{ BUF }", "creating History Buffer");
+
+  const VkDeviceSize wordsPerSnapshot =
+      static_cast<VkDeviceSize>((_control.grid.dimensions[0] + 15) / 16) *
+      _control.grid.dimensions[1];
+  const VkDeviceSize bufferSize =
+      sizeof(uint32_t) *
+      (_history.isEnabled() ? wordsPerSnapshot * _history.getEntryCount() : 1);
+
+  createSharedBuffer(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffers.history,
+                     buffers.historyMemory);
+}
+
+// The recorded alive cells start out dead, so the first frame holds the
+// alive cells themselves. A single word without a recording, binding 8 still
+// wants a buffer.
+void Memory::createRecordingBuffers() {
+  _log.console("{ BUF }", "creating Recording Buffers");
+
+  if (!_recorder.isEnabled()) {
+    createBuffer(sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffers.recording,
+                 buffers.recordingMemory);
+    buffers.recordingReadback = VK_NULL_HANDLE;
+    buffers.recordingReadbackMemory = Allocator::Allocation{};
+    return;
+  }
+
+  const VkDeviceSize frameSize = _recorder.getFrameSize();
+  createSharedBuffer(2 * frameSize,
+                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                         VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+                         VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffers.recording,
+                     buffers.recordingMemory);
+  _uploader.fill(buffers.recording, 0);
+
+  const VkDeviceSize ringSize = frameSize * _control.recording.bufferCount;
+  createBuffer(ringSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
                    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-               stagingBuffer, stagingBufferMemory);
+               buffers.recordingReadback, buffers.recordingReadbackMemory);
+  buffers.recordingMapped = buffers.recordingReadbackMemory.mapped;
+  _recorder.start(buffers.recordingMapped);
+}
+
+// Large enough for a headless submission, which may wrap round the ring
+void Memory::createParameterBuffers() {
+  _log.console("{ BUF }", "creating Parameter Buffers");
+
+  const VkDeviceSize bufferSize =
+      sizeof(GenerationParameters) *
+      std::max(_control.simulation.maxGenerationsPerSubmit,
+               _control.timer.ringSize);
+
+  buffers.parameters.resize(MAX_FRAMES_IN_FLIGHT);
+  buffers.parametersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+  buffers.parametersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+
+  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+    createBuffer(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 buffers.parameters[i], buffers.parametersMemory[i],
+                 Allocator::Usage::parameters);
+
+    buffers.parametersMapped[i] = buffers.parametersMemory[i].mapped;
+  }
+}
+
+// A block per generation a submission may hold, as the parameter buffers.
+// A single word per frame without statistics, binding 9 still wants a buffer.
+void Memory::createStatisticsBuffers() {
+  _log.console("{ BUF }", "creating Statistics Buffers");
+
+  buffers.statistics.resize(MAX_FRAMES_IN_FLIGHT);
+  buffers.statisticsMemory.resize(MAX_FRAMES_IN_FLIGHT);
+  if (!_statistics.isEnabled()) {
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+      createBuffer(sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffers.statistics[i],
+                   buffers.statisticsMemory[i]);
+    }
+    return;
+  }
 
-  void* data;
-  vkMapMemory(_mechanics.mainDevice.logical, stagingBufferMemory, 0, bufferSize,
-              0, &data);
-  std::memcpy(data, cells.data(), static_cast<size_t>(bufferSize));
-  vkUnmapMemory(_mechanics.mainDevice.logical, stagingBufferMemory);
+  const VkDeviceSize bufferSize =
+      sizeof(Statistics::Block) *
+      std::max(_control.simulation.maxGenerationsPerSubmit,
+               _control.timer.ringSize);
 
-  buffers.shaderStorage.resize(MAX_FRAMES_IN_FLIGHT);
-  buffers.shaderStorageMemory.resize(MAX_FRAMES_IN_FLIGHT);
+  buffers.statisticsReadback.resize(MAX_FRAMES_IN_FLIGHT);
+  buffers.statisticsReadbackMemory.resize(MAX_FRAMES_IN_FLIGHT);
+  buffers.statisticsMapped.resize(MAX_FRAMES_IN_FLIGHT);
 
-  // Copy initial Cell data to all storage buffers
   for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-    createBuffer(static_cast<VkDeviceSize>(bufferSize),
+    createBuffer(bufferSize,
                  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
-                     VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+                     VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
                      VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffers.shaderStorage[i],
-                 buffers.shaderStorageMemory[i]);
-    copyBuffer(stagingBuffer, buffers.shaderStorage[i], bufferSize);
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffers.statistics[i],
+                 buffers.statisticsMemory[i]);
+    createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 buffers.statisticsReadback[i],
+                 buffers.statisticsReadbackMemory[i]);
+
+    buffers.statisticsMapped[i] = buffers.statisticsReadbackMemory[i].mapped;
+  }
+}
+
+// The CPU backend starts from the same cells and copies its result into the
+// frame's storage buffer from these persistently mapped buffers
+void Memory::createCpuStagingBuffers(const std::vector<World::Cell>& cells) {
+  _log.console("{ BUF }", "creating CPU Staging Buffers");
+
+  _cpuSimulation.load(cells, _control.simulation.cpuThreads);
+
+  VkDeviceSize bufferSize = sizeof(World::Cell) * cells.size();
+
+  buffers.cpuStaging.resize(MAX_FRAMES_IN_FLIGHT);
+  buffers.cpuStagingMemory.resize(MAX_FRAMES_IN_FLIGHT);
+  buffers.cpuStagingMapped.resize(MAX_FRAMES_IN_FLIGHT);
+
+  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+    createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 buffers.cpuStaging[i], buffers.cpuStagingMemory[i],
+                 Allocator::Usage::cpuMirror);
+
+    buffers.cpuStagingMapped[i] = buffers.cpuStagingMemory[i].mapped;
   }
+}
+
+// Both generations hold the same cells, 32 cells per word with rows padded
+// to whole words
+std::vector<uint32_t> Memory::packCells(const std::vector<World::Cell>& cells) {
+  const uint32_t width = static_cast<uint32_t>(_control.grid.dimensions[0]);
+  const uint32_t height = static_cast<uint32_t>(_control.grid.dimensions[1]);
+  const uint32_t wordsPerRow = (width + 31) / 32;
+  const size_t wordsPerGeneration = static_cast<size_t>(wordsPerRow) * height;
+
+  std::vector<uint32_t> words(wordsPerGeneration * 2, 0);
+  for (uint32_t y = 0; y < height; y++) {
+    for (uint32_t x = 0; x < width; x++) {
+      if (cells[y * width + x].state & 1u) {
+        const uint32_t bit = 1u << (x % 32);
+        words[y * wordsPerRow + x / 32] |= bit;
+        words[wordsPerGeneration + y * wordsPerRow + x / 32] |= bit;
+      }
+    }
+  }
+  return words;
+}
+
+// Indirect dispatch arguments, changed flags for both generation parities
+// and the active tile list. Every tile starts out changed so the next
+// generation steps the whole grid, whatever its parity.
+std::vector<uint32_t> Memory::getInitialActivity() {
+  const uint32_t wordsPerRow = (_control.grid.dimensions[0] + 31) / 32;
+  const uint32_t tilesX = (wordsPerRow + _control.compute.localSizeX - 1) /
+                          _control.compute.localSizeX;
+  const uint32_t tilesY =
+      (_control.grid.dimensions[1] + _control.compute.localSizeY - 1) /
+      _control.compute.localSizeY;
+  const size_t tileCount = static_cast<size_t>(tilesX) * tilesY;
+
+  std::vector<uint32_t> activity(4 + 3 * tileCount, 0);
+  activity[1] = 1;
+  activity[2] = 1;
+  std::fill_n(activity.begin() + 4, 2 * tileCount, 1);
+  return activity;
+}
+
+// Cells of the latest generation in the ring, which must have been reached
+// on the device, see VulkanMechanics::waitForGeneration
+std::vector<World::Cell> Memory::readShaderStorageBuffer() {
+  std::vector<World::Cell> cells(static_cast<size_t>(
+                                     _control.grid.dimensions[0]) *
+                                 _control.grid.dimensions[1]);
+  VkBuffer readbackBuffer;
+  Allocator::Allocation readbackBufferMemory;
+  const World::Cell* data =
+      mapLatestCells(readbackBuffer, readbackBufferMemory);
+  std::memcpy(cells.data(), data, sizeof(World::Cell) * cells.size());
+
+  vkDestroyBuffer(_mechanics.mainDevice.logical, readbackBuffer, nullptr);
+  _allocator.free(readbackBufferMemory);
+  return cells;
+}
 
-  vkDestroyBuffer(_mechanics.mainDevice.logical, stagingBuffer, nullptr);
-  vkFreeMemory(_mechanics.mainDevice.logical, stagingBufferMemory, nullptr);
+// Writes the latest generation in the ring without a host copy of the grid,
+// the device must be idle
+void Memory::saveCheckpoint(const std::string& path) {
+  VkBuffer readbackBuffer;
+  Allocator::Allocation readbackBufferMemory;
+  const World::Cell* cells =
+      mapLatestCells(readbackBuffer, readbackBufferMemory);
+  _checkpoint.save(path, cells);
+
+  vkDestroyBuffer(_mechanics.mainDevice.logical, readbackBuffer, nullptr);
+  _allocator.free(readbackBufferMemory);
+}
+
+// Host visible copy of the latest generation, mapped until the caller
+// destroys it
+const World::Cell* Memory::mapLatestCells(
+    VkBuffer& readbackBuffer,
+    Allocator::Allocation& readbackMemory) {
+  VkDeviceSize bufferSize = sizeof(World::Cell) * _control.grid.dimensions[0] *
+                            _control.grid.dimensions[1];
+  createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+               readbackBuffer, readbackMemory);
+  _uploader.copy(buffers.shaderStorage[_scheduler.getLatestSlot()],
+                 readbackBuffer, bufferSize);
+  _uploader.wait(_uploader.flush());
+
+  return static_cast<const World::Cell*>(readbackMemory.mapped);
+}
+
+// Replaces the grid of both backends once the submissions ordered before it
+// are done, see VulkanMechanics::orderUploadsAfterSubmissions. Submissions
+// from then on wait for the upload on the device, see Uploader.
+void Memory::uploadCells(const std::vector<World::Cell>& cells) {
+  VkDeviceSize bufferSize = sizeof(World::Cell) * cells.size();
+  _uploader.upload(cells.data(), bufferSize, buffers.shaderStorage);
+
+  std::vector<uint32_t> words = packCells(cells);
+  _uploader.upload(words.data(), sizeof(uint32_t) * words.size(),
+                   {buffers.packed});
+
+  std::vector<uint32_t> activity = getInitialActivity();
+  _uploader.upload(activity.data(), sizeof(uint32_t) * activity.size(),
+                   {buffers.activity});
+  _uploader.flush();
+}
+
+// Seeded on the device by initializeWorld. Headless runs draw nothing, the
+// single entry only fills binding 10.
+void Memory::createLandscapeBuffer() {
+  _log.console("{ BUF }", "creating Landscape Buffer");
+
+  const VkDeviceSize cellCount =
+      _control.simulation.headless
+          ? 1
+          : static_cast<VkDeviceSize>(_control.grid.dimensions[0]) *
+                _control.grid.dimensions[1];
+
+  createBuffer(sizeof(World::Landscape) * cellCount,
+               VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+                   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffers.landscape,
+               buffers.landscapeMemory);
 }
 
 void Memory::createUniformBuffers() {
@@ -135,13 +634,12 @@ void Memory::createUniformBuffers() {
   buffers.uniformsMapped.resize(MAX_FRAMES_IN_FLIGHT);
 
   for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-    createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                 buffers.uniforms[i], buffers.uniformsMemory[i]);
+    createSharedBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                           VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                       buffers.uniforms[i], buffers.uniformsMemory[i]);
 
-    vkMapMemory(_mechanics.mainDevice.logical, buffers.uniformsMemory[i], 0,
-                bufferSize, 0, &buffers.uniformsMapped[i]);
+    buffers.uniformsMapped[i] = buffers.uniformsMemory[i].mapped;
   }
 }
 
@@ -160,6 +658,46 @@ void Memory::createDescriptorSetLayout() {
        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
        .pImmutableSamplers = nullptr},
       {.binding = 2,
+       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+       .descriptorCount = 1,
+       .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+       .pImmutableSamplers = nullptr},
+      {.binding = 3,
+       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+       .descriptorCount = 1,
+       .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+       .pImmutableSamplers = nullptr},
+      {.binding = 4,
+       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+       .descriptorCount = 1,
+       .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+       .pImmutableSamplers = nullptr},
+      {.binding = 5,
+       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+       .descriptorCount = 1,
+       .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+       .pImmutableSamplers = nullptr},
+      {.binding = 6,
+       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+       .descriptorCount = 1,
+       .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+       .pImmutableSamplers = nullptr},
+      {.binding = 7,
+       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+       .descriptorCount = 1,
+       .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+       .pImmutableSamplers = nullptr},
+      {.binding = 8,
+       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+       .descriptorCount = 1,
+       .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+       .pImmutableSamplers = nullptr},
+      {.binding = 9,
+       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+       .descriptorCount = 1,
+       .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+       .pImmutableSamplers = nullptr},
+      {.binding = 10,
        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
        .descriptorCount = 1,
        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
@@ -176,15 +714,16 @@ void Memory::createDescriptorSetLayout() {
 
 void Memory::createDescriptorPool() {
   _log.console("{ DES }", "creating Descriptor Pools");
+  const uint32_t setCount =
+      static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT) * _control.timer.ringSize;
   std::vector<VkDescriptorPoolSize> poolSizes{
-      {.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-       .descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT)},
+      {.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, .descriptorCount = setCount},
       {.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-       .descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT) * 2}};
+       .descriptorCount = setCount * 10}};
 
   VkDescriptorPoolCreateInfo poolInfo{
       .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
-      .maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT),
+      .maxSets = setCount,
       .poolSizeCount = static_cast<uint32_t>(poolSizes.size()),
       .pPoolSizes = poolSizes.data()};
 
@@ -200,7 +739,7 @@ void Memory::createImage(uint32_t width,
                          VkImageUsageFlags usage,
                          VkMemoryPropertyFlags properties,
                          VkImage& image,
-                         VkDeviceMemory& imageMemory) {
+                         Allocator::Allocation& imageMemory) {
   VkImageCreateInfo imageInfo{
       .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
       .pNext = nullptr,
@@ -225,49 +764,79 @@ void Memory::createImage(uint32_t width,
   vkGetImageMemoryRequirements(_mechanics.mainDevice.logical, image,
                                &memRequirements);
 
-  VkMemoryAllocateInfo allocateInfo{
-      .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-      .allocationSize = memRequirements.size,
-      .memoryTypeIndex =
-          findMemoryType(memRequirements.memoryTypeBits, properties)};
-
-  _mechanics.result(vkAllocateMemory, _mechanics.mainDevice.logical,
-                    &allocateInfo, nullptr, &imageMemory);
-  vkBindImageMemory(_mechanics.mainDevice.logical, image, imageMemory, 0);
+  imageMemory = _allocator.allocate(
+      memRequirements,
+      findMemoryType(memRequirements.memoryTypeBits, properties),
+      Allocator::Kind::image, Allocator::Usage::attachments);
+  _mechanics.result(vkBindImageMemory, _mechanics.mainDevice.logical, image,
+                    imageMemory.memory, imageMemory.offset);
 }
 
+// One set per frame in flight and ring slot, the slot's set reads the
+// generation in the slot before it and writes the slot
 void Memory::createDescriptorSets() {
   _log.console("{ DES }", "creating Compute Descriptor Sets");
-  std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT,
-                                             descriptor.setLayout);
+  const uint32_t ringSize = _control.timer.ringSize;
+  const size_t setCount = MAX_FRAMES_IN_FLIGHT * ringSize;
+  std::vector<VkDescriptorSetLayout> layouts(setCount, descriptor.setLayout);
   VkDescriptorSetAllocateInfo allocateInfo{
       .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
       .descriptorPool = descriptor.pool,
-      .descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT),
+      .descriptorSetCount = static_cast<uint32_t>(setCount),
       .pSetLayouts = layouts.data()};
 
-  descriptor.sets.resize(MAX_FRAMES_IN_FLIGHT);
+  descriptor.sets.resize(setCount);
   _mechanics.result(vkAllocateDescriptorSets, _mechanics.mainDevice.logical,
                     &allocateInfo, descriptor.sets.data());
 
-  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+  for (size_t i = 0; i < setCount; i++) {
+    const size_t frame = i / ringSize;
+    const size_t slot = i % ringSize;
     VkDescriptorBufferInfo uniformBufferInfo{
-        .buffer = buffers.uniforms[i],
+        .buffer = buffers.uniforms[frame],
         .offset = 0,
         .range = sizeof(World::UniformBufferObject)};
 
     VkDescriptorBufferInfo storageBufferInfoLastFrame{
-        .buffer = buffers.shaderStorage[(i - 1) % MAX_FRAMES_IN_FLIGHT],
+        .buffer = buffers.shaderStorage[(slot + ringSize - 1) % ringSize],
         .offset = 0,
         .range = sizeof(World::Cell) * _control.grid.dimensions[0] *
                  _control.grid.dimensions[1]};
 
     VkDescriptorBufferInfo storageBufferInfoCurrentFrame{
-        .buffer = buffers.shaderStorage[i],
+        .buffer = buffers.shaderStorage[slot],
         .offset = 0,
         .range = sizeof(World::Cell) * _control.grid.dimensions[0] *
                  _control.grid.dimensions[1]};
 
+    VkDescriptorBufferInfo packedBufferInfo{
+        .buffer = buffers.packed, .offset = 0, .range = VK_WHOLE_SIZE};
+
+    VkDescriptorBufferInfo activityBufferInfo{
+        .buffer = buffers.activity, .offset = 0, .range = VK_WHOLE_SIZE};
+
+    VkDescriptorBufferInfo neighbourSumsBufferInfo{
+        .buffer = buffers.neighbourSums, .offset = 0, .range = VK_WHOLE_SIZE};
+
+    VkDescriptorBufferInfo parametersBufferInfo{
+        .buffer = buffers.parameters[frame],
+        .offset = 0,
+        .range = VK_WHOLE_SIZE};
+
+    VkDescriptorBufferInfo historyBufferInfo{
+        .buffer = buffers.history, .offset = 0, .range = VK_WHOLE_SIZE};
+
+    VkDescriptorBufferInfo recordingBufferInfo{
+        .buffer = buffers.recording, .offset = 0, .range = VK_WHOLE_SIZE};
+
+    VkDescriptorBufferInfo statisticsBufferInfo{
+        .buffer = buffers.statistics[frame],
+        .offset = 0,
+        .range = VK_WHOLE_SIZE};
+
+    VkDescriptorBufferInfo landscapeBufferInfo{
+        .buffer = buffers.landscape, .offset = 0, .range = VK_WHOLE_SIZE};
+
     std::vector<VkWriteDescriptorSet> descriptorWrites{
         {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
          .dstSet = descriptor.sets[i],
@@ -291,7 +860,71 @@ void Memory::createDescriptorSets() {
          .dstArrayElement = 0,
          .descriptorCount = 1,
          .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-         .pBufferInfo = &storageBufferInfoCurrentFrame}};
+         .pBufferInfo = &storageBufferInfoCurrentFrame},
+
+        {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+         .dstSet = descriptor.sets[i],
+         .dstBinding = 3,
+         .dstArrayElement = 0,
+         .descriptorCount = 1,
+         .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+         .pBufferInfo = &packedBufferInfo},
+
+        {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+         .dstSet = descriptor.sets[i],
+         .dstBinding = 4,
+         .dstArrayElement = 0,
+         .descriptorCount = 1,
+         .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+         .pBufferInfo = &activityBufferInfo},
+
+        {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+         .dstSet = descriptor.sets[i],
+         .dstBinding = 5,
+         .dstArrayElement = 0,
+         .descriptorCount = 1,
+         .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+         .pBufferInfo = &neighbourSumsBufferInfo},
+
+        {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+         .dstSet = descriptor.sets[i],
+         .dstBinding = 6,
+         .dstArrayElement = 0,
+         .descriptorCount = 1,
+         .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+         .pBufferInfo = &parametersBufferInfo},
+
+        {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+         .dstSet = descriptor.sets[i],
+         .dstBinding = 7,
+         .dstArrayElement = 0,
+         .descriptorCount = 1,
+         .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+         .pBufferInfo = &historyBufferInfo},
+
+        {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+         .dstSet = descriptor.sets[i],
+         .dstBinding = 8,
+         .dstArrayElement = 0,
+         .descriptorCount = 1,
+         .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+         .pBufferInfo = &recordingBufferInfo},
+
+        {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+         .dstSet = descriptor.sets[i],
+         .dstBinding = 9,
+         .dstArrayElement = 0,
+         .descriptorCount = 1,
+         .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+         .pBufferInfo = &statisticsBufferInfo},
+
+        {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+         .dstSet = descriptor.sets[i],
+         .dstBinding = 10,
+         .dstArrayElement = 0,
+         .descriptorCount = 1,
+         .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+         .pBufferInfo = &landscapeBufferInfo}};
 
     vkUpdateDescriptorSets(_mechanics.mainDevice.logical,
                            static_cast<uint32_t>(descriptorWrites.size()),
@@ -305,7 +938,10 @@ void Memory::updateUniformBuffer(uint32_t currentImage) {
               sizeof(uniformObject));
 }
 
-void Memory::recordComputeCommandBuffer(VkCommandBuffer commandBuffer) {
+// Records the generations the scheduler gave this frame, none leaves the
+// latest generation in the ring as it is
+void Memory::recordComputeCommandBuffer(VkCommandBuffer commandBuffer,
+                                        uint32_t generations) {
   VkCommandBufferBeginInfo beginInfo{
       .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
 
@@ -314,19 +950,331 @@ void Memory::recordComputeCommandBuffer(VkCommandBuffer commandBuffer) {
         "failed to begin recording compute command buffer!");
   }
 
+  _profiler.beginPass(commandBuffer, Profiler::Pass::compute);
+  if (_control.simulation.backend == Control::Simulation::Backend::packed) {
+    recordPackedCommands(commandBuffer, generations);
+  } else if (_control.simulation.backend ==
+             Control::Simulation::Backend::cpu) {
+    recordCpuCommands(commandBuffer, generations);
+  } else {
+    recordCellCommands(commandBuffer, generations);
+  }
+  _profiler.endPass(commandBuffer, Profiler::Pass::compute);
+
+  _mechanics.result(vkEndCommandBuffer, commandBuffer);
+}
+
+// Generations after the latest one in the ring
+void Memory::recordCellCommands(VkCommandBuffer commandBuffer,
+                                uint32_t generations) {
+  recordGenerations(commandBuffer,
+                    (_scheduler.getLatestSlot() + 1) % _control.timer.ringSize,
+                    generations);
+  advanceGenerations(generations);
+}
+
+// Generation k writes ring slot firstSlot + k from the slot before it, with
+// the hour at index k of this frame's parameter buffer. Apart from the
+// recorder's changes nothing recorded changes from frame to frame, which
+// prerecorded command buffers rely on. The barrier in front also orders the
+// first generation after the previous submission's last.
+void Memory::recordGenerations(VkCommandBuffer commandBuffer,
+                               uint32_t firstSlot,
+                               uint32_t generations) {
+  uint32_t numberOfWorkgroupsX =
+      (_control.grid.dimensions[0] + _control.compute.localSizeX - 1) /
+      _control.compute.localSizeX;
+  uint32_t numberOfWorkgroupsY =
+      (_control.grid.dimensions[1] + _control.compute.localSizeY - 1) /
+      _control.compute.localSizeY;
+  const uint32_t wordsPerRow = (_control.grid.dimensions[0] + 15) / 16;
+  uint32_t numberOfSnapshotGroupsX =
+      (wordsPerRow + _control.compute.localSizeX - 1) /
+      _control.compute.localSizeX;
+  const VkDeviceSize statisticsSize =
+      sizeof(Statistics::Block) * std::max(generations, 1u);
+  const uint32_t frame = _mechanics.syncObjects.currentFrame;
+
+  if (_statistics.isEnabled()) {
+    vkCmdFillBuffer(commandBuffer, buffers.statistics[frame], 0,
+                    statisticsSize, 0);
+    recordMemoryBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                        VK_ACCESS_TRANSFER_WRITE_BIT,
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+  }
+
+  for (uint32_t i = 0; i < generations; i++) {
+    recordComputeBarrier(commandBuffer);
+    vkCmdBindDescriptorSets(
+        commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+        _pipelines.compute.pipelineLayout, 0, 1,
+        &getDescriptorSet((firstSlot + i) % _control.timer.ringSize), 0,
+        nullptr);
+    recordNeighbourSums(commandBuffer);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                      _pipelines.compute.pipeline);
+
+    pushConstants.data = {i};
+    vkCmdPushConstants(commandBuffer, _pipelines.compute.pipelineLayout,
+                       pushConstants.shaderStage, pushConstants.offset,
+                       pushConstants.size, pushConstants.data.data());
+
+    vkCmdDispatch(commandBuffer, numberOfWorkgroupsX, numberOfWorkgroupsY,
+                  _control.compute.localSizeZ);
+
+    if (_history.isEnabled()) {
+      recordComputeBarrier(commandBuffer);
+      vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                        _pipelines.compute.snapshotPipeline);
+      vkCmdDispatch(commandBuffer, numberOfSnapshotGroupsX, numberOfWorkgroupsY,
+                    _control.compute.localSizeZ);
+    }
+    if (_recorder.isEnabled()) {
+      recordDelta(commandBuffer, i, numberOfWorkgroupsY);
+    }
+  }
+
+  // Read by Statistics::collectResults once the frame comes round again
+  if (_statistics.isEnabled()) {
+    recordMemoryBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        VK_ACCESS_SHADER_WRITE_BIT,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT,
+                        VK_ACCESS_TRANSFER_READ_BIT);
+    VkBufferCopy copyRegion{.size = statisticsSize};
+    vkCmdCopyBuffer(commandBuffer, buffers.statistics[frame],
+                    buffers.statisticsReadback[frame], 1, &copyRegion);
+    recordMemoryBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                        VK_ACCESS_TRANSFER_WRITE_BIT,
+                        VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT);
+  }
+}
+
+// Changes of generation k of this submission, copied into the recorder's next
+// free entry. Skipped when the generation is not due or no entry is free.
+void Memory::recordDelta(VkCommandBuffer commandBuffer,
+                         uint32_t generation,
+                         uint32_t numberOfWorkgroupsY) {
+  const std::optional<uint32_t> entry =
+      _recorder.acquire(_control.simulation.generation + generation + 1,
+                        _control.timer.passedHours + generation + 1);
+  if (!entry) {
+    return;
+  }
+  const VkDeviceSize frameSize = _recorder.getFrameSize();
+  const uint32_t wordsPerRow = (_control.grid.dimensions[0] + 31) / 32;
+
+  // After the generation was written and the previous copy read the changes
+  recordMemoryBarrier(
+      commandBuffer,
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+      VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
   vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
-                    _pipelines.compute.pipeline);
+                    _pipelines.compute.deltaPipeline);
+  vkCmdDispatch(commandBuffer,
+                (wordsPerRow + _control.compute.localSizeX - 1) /
+                    _control.compute.localSizeX,
+                numberOfWorkgroupsY, _control.compute.localSizeZ);
+
+  recordMemoryBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                      VK_ACCESS_SHADER_WRITE_BIT,
+                      VK_PIPELINE_STAGE_TRANSFER_BIT,
+                      VK_ACCESS_TRANSFER_READ_BIT);
+  VkBufferCopy copyRegion{.srcOffset = frameSize,
+                          .dstOffset = frameSize * *entry,
+                          .size = frameSize};
+  vkCmdCopyBuffer(commandBuffer, buffers.recording, buffers.recordingReadback,
+                  1, &copyRegion);
+  recordMemoryBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                      VK_ACCESS_TRANSFER_WRITE_BIT,
+                      VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT);
+}
 
+// Host side of the generations this frame submits: each advances an hour
+// and the generation count into the parameter buffer, and the ring
+void Memory::advanceGenerations(uint32_t generations) {
+  GenerationParameters* parameters = static_cast<GenerationParameters*>(
+      buffers.parametersMapped[_mechanics.syncObjects.currentFrame]);
+  for (uint32_t i = 0; i < generations; i++) {
+    parameters[i] = {.passedHours = ++_control.timer.passedHours,
+                     .generation = ++_control.simulation.generation};
+    _scheduler.advanceSlot();
+    if (_history.isEnabled()) {
+      _history.record(parameters[i].generation, parameters[i].passedHours);
+    }
+  }
+}
+
+// Unpacks the snapshot into the latest slot of the ring, the one the next
+// generation starts from and frames draw, once the submissions ordered
+// before it are done, see VulkanMechanics::orderUploadsAfterSubmissions
+void Memory::restoreSnapshot(const History::Snapshot& snapshot) {
+  VkCommandBufferAllocateInfo allocateInfo{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+      .commandPool = buffers.command.pool,
+      .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+      .commandBufferCount = 1};
+
+  VkCommandBuffer commandBuffer;
+  _mechanics.result(vkAllocateCommandBuffers, _mechanics.mainDevice.logical,
+                    &allocateInfo, &commandBuffer);
+
+  VkCommandBufferBeginInfo beginInfo{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+      .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT};
+  _mechanics.result(vkBeginCommandBuffer, commandBuffer, &beginInfo);
+
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                    _pipelines.compute.restorePipeline);
   vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
                           _pipelines.compute.pipelineLayout, 0, 1,
-                          &descriptor.sets[_mechanics.syncObjects.currentFrame],
-                          0, nullptr);
+                          &getDescriptorSet(_scheduler.getLatestSlot()), 0,
+                          nullptr);
 
-  _control.setPushConstants();
+  pushConstants.data = {snapshot.passedHours, snapshot.entry};
+  vkCmdPushConstants(commandBuffer, _pipelines.compute.pipelineLayout,
+                     pushConstants.shaderStage, pushConstants.offset,
+                     pushConstants.size, pushConstants.data.data());
+
+  vkCmdDispatch(commandBuffer,
+                (_control.grid.dimensions[0] + _control.compute.localSizeX -
+                 1) / _control.compute.localSizeX,
+                (_control.grid.dimensions[1] + _control.compute.localSizeY -
+                 1) / _control.compute.localSizeY,
+                _control.compute.localSizeZ);
+
+  _mechanics.result(vkEndCommandBuffer, commandBuffer);
+  submitOneTime(commandBuffer);
+}
+
+// Random cells unless a checkpoint or pattern is loaded or the CPU backend
+// keeps the cells on the host
+bool Memory::isSeededOnDevice() const {
+  return !_checkpoint.isOpen() && !_pattern.isOpen() &&
+         _control.simulation.backend != Control::Simulation::Backend::cpu;
+}
+
+// Seeds the random cells into the first slot of the ring and the packed grid,
+// then copies them round the ring, and the landscape of a rendered run. See
+// initialize.comp, the same seed always gives the same world.
+void Memory::initializeWorld() {
+  const uint64_t targets = (isSeededOnDevice() ? 1u : 0u) |
+                           (_control.simulation.headless ? 0u : 2u);
+  if (targets == 0) {
+    return;
+  }
+  _log.console("{ BUF }", "seeding the world with seed", _control.grid.seed);
+
+  VkCommandBufferAllocateInfo allocateInfo{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+      .commandPool = buffers.command.pool,
+      .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+      .commandBufferCount = 1};
+
+  VkCommandBuffer commandBuffer;
+  _mechanics.result(vkAllocateCommandBuffers, _mechanics.mainDevice.logical,
+                    &allocateInfo, &commandBuffer);
+
+  VkCommandBufferBeginInfo beginInfo{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+      .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT};
+  _mechanics.result(vkBeginCommandBuffer, commandBuffer, &beginInfo);
+
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                    _pipelines.compute.initializePipeline);
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          _pipelines.compute.pipelineLayout, 0, 1,
+                          &getDescriptorSet(0), 0, nullptr);
+
+  pushConstants.data = {Random::getKey(_control.grid.seed), targets};
+  vkCmdPushConstants(commandBuffer, _pipelines.compute.pipelineLayout,
+                     pushConstants.shaderStage, pushConstants.offset,
+                     pushConstants.size, pushConstants.data.data());
+
+  vkCmdDispatch(commandBuffer,
+                (_control.grid.dimensions[0] + _control.compute.localSizeX -
+                 1) / _control.compute.localSizeX,
+                (_control.grid.dimensions[1] + _control.compute.localSizeY -
+                 1) / _control.compute.localSizeY,
+                _control.compute.localSizeZ);
+
+  if (isSeededOnDevice()) {
+    recordMemoryBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        VK_ACCESS_SHADER_WRITE_BIT,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT,
+                        VK_ACCESS_TRANSFER_READ_BIT);
+    const VkBufferCopy copyRegion{
+        .size = sizeof(World::Cell) * _control.grid.dimensions[0] *
+                _control.grid.dimensions[1]};
+    for (size_t i = 1; i < buffers.shaderStorage.size(); i++) {
+      vkCmdCopyBuffer(commandBuffer, buffers.shaderStorage[0],
+                      buffers.shaderStorage[i], 1, &copyRegion);
+    }
+  }
+
+  _mechanics.result(vkEndCommandBuffer, commandBuffer);
+  submitOneTime(commandBuffer);
+}
+
+// Unpacks the streamed pattern, generation 0 of the packed grid, into every
+// slot of the ring
+void Memory::expandPattern() {
+  VkCommandBufferAllocateInfo allocateInfo{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+      .commandPool = buffers.command.pool,
+      .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+      .commandBufferCount = 1};
+
+  VkCommandBuffer commandBuffer;
+  _mechanics.result(vkAllocateCommandBuffers, _mechanics.mainDevice.logical,
+                    &allocateInfo, &commandBuffer);
+
+  VkCommandBufferBeginInfo beginInfo{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+      .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT};
+  _mechanics.result(vkBeginCommandBuffer, commandBuffer, &beginInfo);
+
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                    _pipelines.compute.expandPipeline);
+  pushConstants.data = {0, 0};
   vkCmdPushConstants(commandBuffer, _pipelines.compute.pipelineLayout,
                      pushConstants.shaderStage, pushConstants.offset,
                      pushConstants.size, pushConstants.data.data());
 
+  for (uint32_t slot = 0; slot < _control.timer.ringSize; slot++) {
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                            _pipelines.compute.pipelineLayout, 0, 1,
+                            &getDescriptorSet(slot), 0, nullptr);
+    vkCmdDispatch(commandBuffer,
+                  (_control.grid.dimensions[0] + _control.compute.localSizeX -
+                   1) / _control.compute.localSizeX,
+                  (_control.grid.dimensions[1] + _control.compute.localSizeY -
+                   1) / _control.compute.localSizeY,
+                  _control.compute.localSizeZ);
+  }
+
+  _mechanics.result(vkEndCommandBuffer, commandBuffer);
+  submitOneTime(commandBuffer);
+}
+
+// Advances the packed grid by generationsPerStep per scheduled step, or
+// towards a pending fast forward, then expands the current generation into
+// the next slot of the ring. Each generation dispatches only the tiles
+// around last generation's changes, see activity.comp.
+void Memory::recordPackedCommands(VkCommandBuffer commandBuffer,
+                                  uint32_t steps) {
+  const uint32_t wordsPerRow = (_control.grid.dimensions[0] + 31) / 32;
+  const uint32_t tilesX = (wordsPerRow + _control.compute.localSizeX - 1) /
+                          _control.compute.localSizeX;
+  const uint32_t tilesY =
+      (_control.grid.dimensions[1] + _control.compute.localSizeY - 1) /
+      _control.compute.localSizeY;
+
+  uint32_t numberOfTileGroupsX =
+      (tilesX + _control.compute.localSizeX - 1) / _control.compute.localSizeX;
+  uint32_t numberOfTileGroupsY =
+      (tilesY + _control.compute.localSizeY - 1) / _control.compute.localSizeY;
   uint32_t numberOfWorkgroupsX =
       (_control.grid.dimensions[0] + _control.compute.localSizeX - 1) /
       _control.compute.localSizeX;
@@ -334,14 +1282,224 @@ void Memory::recordComputeCommandBuffer(VkCommandBuffer commandBuffer) {
       (_control.grid.dimensions[1] + _control.compute.localSizeY - 1) /
       _control.compute.localSizeY;
 
+  Control::Simulation& simulation = _control.simulation;
+  uint64_t generations =
+      static_cast<uint64_t>(steps) * simulation.generationsPerStep;
+  _control.timer.passedHours += steps;
+  if (simulation.targetGeneration > simulation.generation) {
+    generations = std::max(
+        generations,
+        std::min<uint64_t>(simulation.targetGeneration - simulation.generation,
+                           simulation.maxGenerationsPerSubmit));
+  }
+
+  if (generations == 0) {
+    return;
+  }
+
+  // Previous submissions may still write the generation read below
+  recordComputeBarrier(commandBuffer);
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          _pipelines.compute.pipelineLayout, 0, 1,
+                          &getDescriptorSet(_scheduler.getLatestSlot()), 0,
+                          nullptr);
+
+  for (uint64_t i = 0; i < generations; i++) {
+    _control.setPushConstants();
+    recordActiveTiles(commandBuffer, numberOfTileGroupsX, numberOfTileGroupsY);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                      _pipelines.compute.packedPipeline);
+    vkCmdPushConstants(commandBuffer, _pipelines.compute.pipelineLayout,
+                       pushConstants.shaderStage, pushConstants.offset,
+                       pushConstants.size, pushConstants.data.data());
+
+    vkCmdDispatchIndirect(commandBuffer, buffers.activity, 0);
+
+    recordComputeBarrier(commandBuffer);
+    simulation.generation++;
+
+    if (simulation.generation == simulation.targetGeneration) {
+      _log.console("{ SIM }", "fast forwarded to generation",
+                   simulation.generation);
+    }
+  }
+
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          _pipelines.compute.pipelineLayout, 0, 1,
+                          &getDescriptorSet(_scheduler.advanceSlot()), 0,
+                          nullptr);
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                    _pipelines.compute.expandPipeline);
+
+  _control.setPushConstants();
+  vkCmdPushConstants(commandBuffer, _pipelines.compute.pipelineLayout,
+                     pushConstants.shaderStage, pushConstants.offset,
+                     pushConstants.size, pushConstants.data.data());
+
   vkCmdDispatch(commandBuffer, numberOfWorkgroupsX, numberOfWorkgroupsY,
                 _control.compute.localSizeZ);
+}
+
+// Records up to maxGenerationsPerSubmit generations towards the target,
+// written round the ring as in a rendered frame. Queries firstTimestamp and
+// the one after it of timestamps, if given, bracket the recorded work.
+void Memory::recordHeadlessCommandBuffer(VkCommandBuffer commandBuffer,
+                                         VkQueryPool timestamps,
+                                         uint32_t firstTimestamp) {
+  VkCommandBufferBeginInfo beginInfo{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+      .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT};
+  _mechanics.result(vkBeginCommandBuffer, commandBuffer, &beginInfo);
+
+  if (timestamps != VK_NULL_HANDLE) {
+    vkCmdResetQueryPool(commandBuffer, timestamps, firstTimestamp, 2);
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                        timestamps, firstTimestamp);
+  }
 
+  Control::Simulation& simulation = _control.simulation;
+
+  if (simulation.backend == Control::Simulation::Backend::packed) {
+    recordPackedCommands(commandBuffer, 0);
+  } else {
+    recordCellCommands(
+        commandBuffer,
+        static_cast<uint32_t>(std::min<uint64_t>(
+            simulation.targetGeneration - simulation.generation,
+            simulation.maxGenerationsPerSubmit)));
+  }
+
+  if (timestamps != VK_NULL_HANDLE) {
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                        timestamps, firstTimestamp + 1);
+  }
   _mechanics.result(vkEndCommandBuffer, commandBuffer);
 }
 
+// Steps the CPU simulation once per scheduled generation and copies the
+// result into the next slot of the ring. The wait for this frame's last
+// submissions guards the staging buffer.
+void Memory::recordCpuCommands(VkCommandBuffer commandBuffer,
+                               uint32_t generations) {
+  Control::Simulation& simulation = _control.simulation;
+  for (uint32_t i = 0; i < generations; i++) {
+    _control.timer.passedHours++;
+    _cpuSimulation.step(_control.timer.passedHours);
+    simulation.generation++;
+  }
+  if (generations == 0) {
+    return;
+  }
+
+  const std::vector<World::Cell>& cells = _cpuSimulation.getCells();
+  VkDeviceSize bufferSize = sizeof(World::Cell) * cells.size();
+  std::memcpy(buffers.cpuStagingMapped[_mechanics.syncObjects.currentFrame],
+              cells.data(), static_cast<size_t>(bufferSize));
+
+  VkBufferCopy copyRegion{.size = bufferSize};
+  vkCmdCopyBuffer(commandBuffer,
+                  buffers.cpuStaging[_mechanics.syncObjects.currentFrame],
+                  buffers.shaderStorage[_scheduler.advanceSlot()], 1,
+                  &copyRegion);
+}
+
+// Rebuilds the active tile list and the indirect dispatch size for the
+// generation in the push constants
+void Memory::recordActiveTiles(VkCommandBuffer commandBuffer,
+                               uint32_t numberOfTileGroupsX,
+                               uint32_t numberOfTileGroupsY) {
+  const VkPipelineStageFlags indirectStages =
+      VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+  recordMemoryBarrier(commandBuffer, indirectStages, VK_ACCESS_SHADER_WRITE_BIT,
+                      VK_PIPELINE_STAGE_TRANSFER_BIT,
+                      VK_ACCESS_TRANSFER_WRITE_BIT);
+  vkCmdFillBuffer(commandBuffer, buffers.activity, 0, sizeof(uint32_t), 0);
+  recordMemoryBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                      VK_ACCESS_TRANSFER_WRITE_BIT,
+                      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                      VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                    _pipelines.compute.activityPipeline);
+  vkCmdPushConstants(commandBuffer, _pipelines.compute.pipelineLayout,
+                     pushConstants.shaderStage, pushConstants.offset,
+                     pushConstants.size, pushConstants.data.data());
+  vkCmdDispatch(commandBuffer, numberOfTileGroupsX, numberOfTileGroupsY,
+                _control.compute.localSizeZ);
+
+  recordMemoryBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                      VK_ACCESS_SHADER_WRITE_BIT, indirectStages,
+                      VK_ACCESS_INDIRECT_COMMAND_READ_BIT |
+                          VK_ACCESS_SHADER_READ_BIT |
+                          VK_ACCESS_SHADER_WRITE_BIT);
+}
+
+// Larger than Life box counts of the last generation, in two separable
+// running sum passes, see rangeColumns.comp and rangeRows.comp. The first
+// barrier also orders the passes after the previous frame's compute work.
+void Memory::recordNeighbourSums(VkCommandBuffer commandBuffer) {
+  if (_control.getRule().radius == 1) {
+    return;
+  }
+  const uint32_t width = _control.grid.dimensions[0];
+  const uint32_t height = _control.grid.dimensions[1];
+  const uint32_t runLength = _control.compute.runLength;
+  const uint32_t localSizeX = _control.compute.localSizeX;
+  const uint32_t localSizeY = _control.compute.localSizeY;
+  const uint32_t runsX = (width + runLength - 1) / runLength;
+  const uint32_t runsY = (height + runLength - 1) / runLength;
+
+  recordComputeBarrier(commandBuffer);
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                    _pipelines.compute.columnsPipeline);
+  vkCmdDispatch(commandBuffer, (width + localSizeX - 1) / localSizeX,
+                (runsY + localSizeY - 1) / localSizeY,
+                _control.compute.localSizeZ);
+
+  recordComputeBarrier(commandBuffer);
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                    _pipelines.compute.rowsPipeline);
+  vkCmdDispatch(commandBuffer, (runsX + localSizeX - 1) / localSizeX,
+                (height + localSizeY - 1) / localSizeY,
+                _control.compute.localSizeZ);
+
+  recordComputeBarrier(commandBuffer);
+}
+
+// Set of this frame in flight for the ring slot written
+VkDescriptorSet& Memory::getDescriptorSet(uint32_t slot) {
+  return descriptor.sets[_mechanics.syncObjects.currentFrame *
+                             _control.timer.ringSize +
+                         slot];
+}
+
+void Memory::recordComputeBarrier(VkCommandBuffer commandBuffer) {
+  recordMemoryBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                      VK_ACCESS_SHADER_WRITE_BIT,
+                      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                      VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+}
+
+void Memory::recordMemoryBarrier(VkCommandBuffer commandBuffer,
+                                 VkPipelineStageFlags srcStage,
+                                 VkAccessFlags srcAccess,
+                                 VkPipelineStageFlags dstStage,
+                                 VkAccessFlags dstAccess) {
+  VkMemoryBarrier memoryBarrier{.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                                .srcAccessMask = srcAccess,
+                                .dstAccessMask = dstAccess};
+
+  vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 1, &memoryBarrier,
+                       0, nullptr, 0, nullptr);
+}
+
+// Draws the generation in the ring slot
 void Memory::recordCommandBuffer(VkCommandBuffer commandBuffer,
-                                 uint32_t imageIndex) {
+                                 uint32_t imageIndex,
+                                 uint32_t slot) {
   VkCommandBufferBeginInfo beginInfo{
       .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
 
@@ -359,6 +1517,7 @@ void Memory::recordCommandBuffer(VkCommandBuffer commandBuffer,
       .clearValueCount = static_cast<uint32_t>(clearValues.size()),
       .pClearValues = clearValues.data()};
 
+  _profiler.beginPass(commandBuffer, Profiler::Pass::render);
   vkCmdBeginRenderPass(commandBuffer, &renderPassInfo,
                        VK_SUBPASS_CONTENTS_INLINE);
 
@@ -377,21 +1536,22 @@ void Memory::recordCommandBuffer(VkCommandBuffer commandBuffer,
   VkRect2D scissor{.offset = {0, 0}, .extent = _mechanics.swapChain.extent};
   vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-  VkDeviceSize offsets[]{0};
-  vkCmdBindVertexBuffers(
-      commandBuffer, 0, 1,
-      &_memory.buffers.shaderStorage[_mechanics.syncObjects.currentFrame],
-      offsets);
+  std::array<VkBuffer, 2> vertexBuffers{buffers.shaderStorage[slot],
+                                        buffers.landscape};
+  std::array<VkDeviceSize, 2> offsets{0, 0};
+  vkCmdBindVertexBuffers(commandBuffer, 0,
+                         static_cast<uint32_t>(vertexBuffers.size()),
+                         vertexBuffers.data(), offsets.data());
 
   vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
                           _pipelines.graphics.pipelineLayout, 0, 1,
-                          &descriptor.sets[_mechanics.syncObjects.currentFrame],
-                          0, nullptr);
+                          &getDescriptorSet(slot), 0, nullptr);
 
   vkCmdDraw(commandBuffer, _world.tile.vertexCount,
             _control.grid.dimensions[0] * _control.grid.dimensions[1], 0, 0);
 
   vkCmdEndRenderPass(commandBuffer);
+  _profiler.endPass(commandBuffer, Profiler::Pass::render);
 
   _mechanics.result(vkEndCommandBuffer, commandBuffer);
 }
@@ -400,12 +1560,52 @@ void Memory::createBuffer(VkDeviceSize size,
                           VkBufferUsageFlags usage,
                           VkMemoryPropertyFlags properties,
                           VkBuffer& buffer,
-                          VkDeviceMemory& bufferMemory) {
+                          Allocator::Allocation& bufferMemory,
+                          std::optional<Allocator::Usage> memoryUsage) {
+  VkBufferCreateInfo bufferInfo{.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+                                .size = size,
+                                .usage = usage,
+                                .sharingMode = VK_SHARING_MODE_EXCLUSIVE};
+  allocateBuffer(bufferInfo, properties, buffer, bufferMemory, memoryUsage);
+}
+
+// For buffers all queues use. With a separate compute family the compute
+// pass of the next frame reads the cells the graphics queue is still drawing,
+// and a separate transfer family uploads into them, so the buffers are
+// concurrent rather than handed over between families.
+void Memory::createSharedBuffer(VkDeviceSize size,
+                                VkBufferUsageFlags usage,
+                                VkMemoryPropertyFlags properties,
+                                VkBuffer& buffer,
+                                Allocator::Allocation& bufferMemory) {
+  const VulkanMechanics::Queues::FamilyIndices& indices =
+      _mechanics.queues.familyIndices;
+  std::vector<uint32_t> families{indices.graphicsAndComputeFamily.value()};
+  if (indices.hasAsyncCompute()) {
+    families.push_back(indices.computeFamily.value());
+  }
+  if (indices.hasTransferQueue()) {
+    families.push_back(indices.transferFamily.value());
+  }
+
   VkBufferCreateInfo bufferInfo{.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
                                 .size = size,
                                 .usage = usage,
                                 .sharingMode = VK_SHARING_MODE_EXCLUSIVE};
+  if (families.size() > 1) {
+    bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+    bufferInfo.queueFamilyIndexCount = static_cast<uint32_t>(families.size());
+    bufferInfo.pQueueFamilyIndices = families.data();
+  }
+  allocateBuffer(bufferInfo, properties, buffer, bufferMemory);
+}
 
+// Without a memory usage one is derived from the flags, see Allocator::Usage
+void Memory::allocateBuffer(const VkBufferCreateInfo& bufferInfo,
+                            VkMemoryPropertyFlags properties,
+                            VkBuffer& buffer,
+                            Allocator::Allocation& bufferMemory,
+                            std::optional<Allocator::Usage> memoryUsage) {
   _log.console("{ ... }",
                "creating Buffer:", _log.getBufferUsageString(bufferInfo.usage));
   _log.console(_log.style.charLeader, bufferInfo.size, "bytes");
@@ -417,51 +1617,40 @@ void Memory::createBuffer(VkDeviceSize size,
   vkGetBufferMemoryRequirements(_mechanics.mainDevice.logical, buffer,
                                 &memRequirements);
 
-  VkMemoryAllocateInfo allocateInfo{
-      .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-      .allocationSize = memRequirements.size,
-      .memoryTypeIndex =
-          findMemoryType(memRequirements.memoryTypeBits, properties)};
-
-  _mechanics.result(vkAllocateMemory, _mechanics.mainDevice.logical,
-                    &allocateInfo, nullptr, &bufferMemory);
+  // Host visible buffers other than uniform buffers stage or read back data
+  Allocator::Usage usage = Allocator::Usage::simulation;
+  if (bufferInfo.usage & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT) {
+    usage = Allocator::Usage::uniforms;
+  } else if (properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+    usage = Allocator::Usage::staging;
+  }
+  bufferMemory = _allocator.allocate(
+      memRequirements,
+      findMemoryType(memRequirements.memoryTypeBits, properties),
+      Allocator::Kind::buffer, memoryUsage.value_or(usage));
 
-  vkBindBufferMemory(_mechanics.mainDevice.logical, buffer, bufferMemory, 0);
+  _mechanics.result(vkBindBufferMemory, _mechanics.mainDevice.logical, buffer,
+                    bufferMemory.memory, bufferMemory.offset);
 }
 
-void Memory::copyBuffer(VkBuffer srcBuffer,
-                        VkBuffer dstBuffer,
-                        VkDeviceSize size) {
-  VkCommandBufferAllocateInfo allocateInfo{
-      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-      .commandPool = buffers.command.pool,
-      .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-      .commandBufferCount = 1};
-
-  VkCommandBuffer commandBuffer;
-  vkAllocateCommandBuffers(_mechanics.mainDevice.logical, &allocateInfo,
-                           &commandBuffer);
-
-  VkCommandBufferBeginInfo beginInfo{
-      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-      .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT};
-
-  vkBeginCommandBuffer(commandBuffer, &beginInfo);
-
-  VkBufferCopy copyRegion{.size = size};
-  vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-
-  vkEndCommandBuffer(commandBuffer);
-
-  VkSubmitInfo submitInfo{.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-                          .commandBufferCount = 1,
-                          .pCommandBuffers = &commandBuffer};
-
-  vkQueueSubmit(_mechanics.queues.graphics, 1, &submitInfo, VK_NULL_HANDLE);
-  vkQueueWaitIdle(_mechanics.queues.graphics);
-
-  vkFreeCommandBuffers(_mechanics.mainDevice.logical, buffers.command.pool, 1,
-                       &commandBuffer);
+// Submits a command buffer allocated from the graphics pool once every upload
+// flushed so far is done. It takes the next value of the upload timeline,
+// so whatever waits for the uploads waits for it too and nothing blocks
+// here. Command buffers of earlier calls that are done are freed.
+void Memory::submitOneTime(VkCommandBuffer commandBuffer) {
+  std::vector<std::pair<VkCommandBuffer, uint64_t>>& oneTime =
+      buffers.command.oneTime;
+  std::erase_if(oneTime, [this](const auto& submitted) {
+    if (!_uploader.isReached(submitted.second)) {
+      return false;
+    }
+    vkFreeCommandBuffers(_mechanics.mainDevice.logical, buffers.command.pool,
+                         1, &submitted.first);
+    return true;
+  });
+  oneTime.emplace_back(commandBuffer,
+                       _uploader.submit(_mechanics.queues.graphics,
+                                        commandBuffer));
 }
 
 uint32_t Memory::findMemoryType(uint32_t typeFilter,
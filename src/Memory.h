@@ -3,9 +3,16 @@
 #include "vulkan/vulkan.h"
 
 #include <cstring>
+#include <optional>
 #include "array"
+#include "string"
+#include "utility"
 #include "vector"
 
+#include "Allocator.h"
+#include "History.h"
+#include "World.h"
+
 class Memory {
  public:
   Memory();
@@ -18,24 +25,84 @@ class Memory {
     std::array<uint64_t, 32> data;
   } pushConstants;
 
+  // Hour and generation of each generation a submission computes, indexed by
+  // the push constant of shader.comp
+  struct GenerationParameters {
+    uint64_t passedHours;
+    uint64_t generation;
+  };
+
   struct Buffers {
+    // Ring of cell generations, see Scheduler
     std::vector<VkBuffer> shaderStorage;
-    std::vector<VkDeviceMemory> shaderStorageMemory;
+    std::vector<Allocator::Allocation> shaderStorageMemory;
+
+    VkBuffer landscape;
+    Allocator::Allocation landscapeMemory;
+
+    VkBuffer packed;
+    Allocator::Allocation packedMemory;
+
+    VkBuffer activity;
+    Allocator::Allocation activityMemory;
+
+    // Larger than Life column sums, then box counts, one word per cell each
+    VkBuffer neighbourSums;
+    Allocator::Allocation neighbourSumsMemory;
+
+    // CPU backend: host visible copies of each frame's cells
+    std::vector<VkBuffer> cpuStaging;
+    std::vector<Allocator::Allocation> cpuStagingMemory;
+    std::vector<void*> cpuStagingMapped;
+
+    // Snapshots of past generations, see History
+    VkBuffer history;
+    Allocator::Allocation historyMemory;
+
+    // Alive cells of the last recorded generation and its changes, see
+    // delta.comp, and the host visible ring they are copied into
+    VkBuffer recording;
+    Allocator::Allocation recordingMemory;
+    VkBuffer recordingReadback;
+    Allocator::Allocation recordingReadbackMemory;
+    void* recordingMapped;
+
+    // Statistics::Block of each generation of a frame's submission, and the
+    // host visible copy they are read from
+    std::vector<VkBuffer> statistics;
+    std::vector<Allocator::Allocation> statisticsMemory;
+    std::vector<VkBuffer> statisticsReadback;
+    std::vector<Allocator::Allocation> statisticsReadbackMemory;
+    std::vector<void*> statisticsMapped;
+
+    // GenerationParameters of a frame's submission, see advanceGenerations
+    std::vector<VkBuffer> parameters;
+    std::vector<Allocator::Allocation> parametersMemory;
+    std::vector<void*> parametersMapped;
 
     std::vector<VkBuffer> uniforms;
-    std::vector<VkDeviceMemory> uniformsMemory;
+    std::vector<Allocator::Allocation> uniformsMemory;
     std::vector<void*> uniformsMapped;
 
     struct CommandBuffers {
       VkCommandPool pool;
+      // Compute command buffers, on the compute queue's family
+      VkCommandPool computePool;
       std::vector<VkCommandBuffer> graphic;
       std::vector<VkCommandBuffer> compute;
+      // Prerecorded mode, see createPrerecordedCommandBuffers
+      std::vector<VkCommandBuffer> prerecordedGraphic;
+      std::vector<VkCommandBuffer> prerecordedCompute;
+      // Submitted one-time command buffers and the upload timeline value
+      // that frees each, see submitOneTime
+      std::vector<std::pair<VkCommandBuffer, uint64_t>> oneTime;
     } command;
   } buffers;
 
   struct DescriptorSets {
     VkDescriptorPool pool;
     VkDescriptorSetLayout setLayout;
+    // Per frame in flight, one set per ring slot
     std::vector<VkDescriptorSet> sets;
   } descriptor;
 
@@ -45,15 +112,35 @@ class Memory {
   void createCommandPool();
   void createCommandBuffers();
   void createComputeCommandBuffers();
+  void createPrerecordedCommandBuffers();
+  VkCommandBuffer& getPrerecordedGraphic(uint32_t imageIndex);
+  VkCommandBuffer& getPrerecordedCompute(uint32_t generations);
 
   void createDescriptorPool();
   void createDescriptorSetLayout();
   void createDescriptorSets();
 
-  void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex);
-  void recordComputeCommandBuffer(VkCommandBuffer commandBuffer);
+  void recordCommandBuffer(VkCommandBuffer commandBuffer,
+                           uint32_t imageIndex,
+                           uint32_t slot);
+  void recordComputeCommandBuffer(VkCommandBuffer commandBuffer,
+                                  uint32_t generations);
+  void recordCellCommands(VkCommandBuffer commandBuffer, uint32_t generations);
+  void advanceGenerations(uint32_t generations);
+  void recordPackedCommands(VkCommandBuffer commandBuffer, uint32_t steps);
+  void recordCpuCommands(VkCommandBuffer commandBuffer, uint32_t generations);
+  void recordHeadlessCommandBuffer(VkCommandBuffer commandBuffer,
+                                   VkQueryPool timestamps,
+                                   uint32_t firstTimestamp);
 
   void createShaderStorageBuffers();
+  void createLandscapeBuffer();
+  std::vector<World::Cell> readShaderStorageBuffer();
+  void uploadCells(const std::vector<World::Cell>& cells);
+  void restoreSnapshot(const History::Snapshot& snapshot);
+  void saveCheckpoint(const std::string& path);
+  void initializeWorld();
+  void expandPattern();
 
   void createUniformBuffers();
   void updateUniformBuffer(uint32_t currentImage);
@@ -66,15 +153,58 @@ class Memory {
                    VkImageUsageFlags usage,
                    VkMemoryPropertyFlags properties,
                    VkImage& image,
-                   VkDeviceMemory& imageMemory);
-
- private:
+                   Allocator::Allocation& imageMemory);
   void createBuffer(VkDeviceSize size,
                     VkBufferUsageFlags usage,
                     VkMemoryPropertyFlags properties,
                     VkBuffer& buffer,
-                    VkDeviceMemory& bufferMemory);
+                    Allocator::Allocation& bufferMemory,
+                    std::optional<Allocator::Usage> memoryUsage = {});
+
+ private:
+  void createSharedBuffer(VkDeviceSize size,
+                          VkBufferUsageFlags usage,
+                          VkMemoryPropertyFlags properties,
+                          VkBuffer& buffer,
+                          Allocator::Allocation& bufferMemory);
+  void allocateBuffer(const VkBufferCreateInfo& bufferInfo,
+                      VkMemoryPropertyFlags properties,
+                      VkBuffer& buffer,
+                      Allocator::Allocation& bufferMemory,
+                      std::optional<Allocator::Usage> memoryUsage = {});
+  void createPackedStorageBuffer(const std::vector<World::Cell>& cells);
+  void uploadCheckpoint();
+  void uploadPattern();
+  bool isSeededOnDevice() const;
+  const World::Cell* mapLatestCells(VkBuffer& readbackBuffer,
+                                    Allocator::Allocation& readbackMemory);
+  void createActivityBuffer();
+  void createNeighbourSumBuffer();
+  void createHistoryBuffer();
+  void createRecordingBuffers();
+  void createStatisticsBuffers();
+  void recordDelta(VkCommandBuffer commandBuffer,
+                   uint32_t generation,
+                   uint32_t numberOfWorkgroupsY);
+  void createParameterBuffers();
+  void recordGenerations(VkCommandBuffer commandBuffer,
+                         uint32_t firstSlot,
+                         uint32_t generations);
+  void recordNeighbourSums(VkCommandBuffer commandBuffer);
+  void createCpuStagingBuffers(const std::vector<World::Cell>& cells);
+  std::vector<uint32_t> packCells(const std::vector<World::Cell>& cells);
+  std::vector<uint32_t> getInitialActivity();
+  void recordActiveTiles(VkCommandBuffer commandBuffer,
+                         uint32_t numberOfTileGroupsX,
+                         uint32_t numberOfTileGroupsY);
+  VkDescriptorSet& getDescriptorSet(uint32_t slot);
+  void recordComputeBarrier(VkCommandBuffer commandBuffer);
+  void recordMemoryBarrier(VkCommandBuffer commandBuffer,
+                           VkPipelineStageFlags srcStage,
+                           VkAccessFlags srcAccess,
+                           VkPipelineStageFlags dstStage,
+                           VkAccessFlags dstAccess);
+  void submitOneTime(VkCommandBuffer commandBuffer);
   uint32_t findMemoryType(uint32_t typeFilter,
                           VkMemoryPropertyFlags properties);
-  void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
 };
@@ -0,0 +1,228 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include "CapitalEngine.h"
+#include "MemoryTelemetry.h"
+
+namespace {
+// Precedes every host allocation: its size and the start of the block it was
+// aligned in
+struct Header {
+  size_t size;
+  void* block;
+};
+
+Header& getHeader(void* memory) {
+  return *(static_cast<Header*>(memory) - 1);
+}
+}  // namespace
+
+MemoryTelemetry::MemoryTelemetry()
+    : budgetSupported{false},
+      callbacks{.pUserData = this,
+                .pfnAllocation = allocate,
+                .pfnReallocation = reallocate,
+                .pfnFree = free,
+                .pfnInternalAllocation = notifyInternalAllocation,
+                .pfnInternalFree = notifyInternalFree} {
+  _log.console("{ MEM }", "constructing Memory Telemetry");
+}
+
+MemoryTelemetry::~MemoryTelemetry() {
+  _log.console("{ MEM }", "destructing Memory Telemetry");
+}
+
+// VK_EXT_memory_budget is enabled with the device when this returns true
+bool MemoryTelemetry::checkBudgetSupport(VkPhysicalDevice physicalDevice) {
+  uint32_t extensionCount;
+  vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount,
+                                       nullptr);
+  std::vector<VkExtensionProperties> extensions(extensionCount);
+  vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount,
+                                       extensions.data());
+
+  budgetSupported = std::any_of(
+      extensions.begin(), extensions.end(),
+      [](const VkExtensionProperties& extension) {
+        return std::strcmp(extension.extensionName,
+                           VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0;
+      });
+  return budgetSupported;
+}
+
+// Objects created with the callbacks are destroyed with them
+const VkAllocationCallbacks* MemoryTelemetry::getCallbacks() const {
+  return &callbacks;
+}
+
+MemoryTelemetry::Report MemoryTelemetry::getReport() const {
+  Report report{.budgetSupported = budgetSupported};
+
+  VkPhysicalDeviceMemoryBudgetPropertiesEXT budget{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT};
+  VkPhysicalDeviceMemoryProperties2 properties{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2,
+      .pNext = budgetSupported ? &budget : nullptr};
+  vkGetPhysicalDeviceMemoryProperties2(_mechanics.mainDevice.physical,
+                                       &properties);
+
+  const Allocator::Statistics statistics = _allocator.getStatistics();
+  const VkPhysicalDeviceMemoryProperties& memory = properties.memoryProperties;
+  for (uint32_t i = 0; i < memory.memoryHeapCount; i++) {
+    const VkMemoryHeap& heap = memory.memoryHeaps[i];
+    report.heaps.push_back(
+        {.size = heap.size,
+         .budget = budgetSupported ? budget.heapBudget[i] : heap.size,
+         .usage = budgetSupported ? budget.heapUsage[i]
+                                  : statistics.heapBytes[i],
+         .deviceLocal = (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0});
+  }
+  report.usageBytes = statistics.usageBytes;
+  report.swapChainBytes = sizeof(uint32_t) *
+                          _mechanics.swapChain.images.size() *
+                          _mechanics.swapChain.extent.width *
+                          _mechanics.swapChain.extent.height;
+  report.host = {.liveBytes = hostCounters.liveBytes,
+                 .peakBytes = hostCounters.peakBytes,
+                 .liveCount = hostCounters.liveCount,
+                 .internalBytes = hostCounters.internalBytes};
+
+  // Everything but the simulation's buffers stays as the grid grows
+  const VkDeviceSize simulationBytes = report.usageBytes[static_cast<size_t>(
+      Allocator::Usage::simulation)];
+  const uint64_t cellCount =
+      static_cast<uint64_t>(_control.grid.dimensions[0]) *
+      _control.grid.dimensions[1];
+  auto largest = std::max_element(
+      report.heaps.begin(), report.heaps.end(),
+      [](const Heap& a, const Heap& b) {
+        return (a.deviceLocal ? a.size : 0) < (b.deviceLocal ? b.size : 0);
+      });
+  if (simulationBytes > 0 && largest != report.heaps.end()) {
+    const VkDeviceSize fixedBytes =
+        largest->usage - std::min(largest->usage, simulationBytes);
+    const double bytesPerCell =
+        static_cast<double>(simulationBytes) / static_cast<double>(cellCount);
+    report.cellCapacity = static_cast<uint64_t>(
+        static_cast<double>(largest->budget -
+                            std::min(largest->budget, fixedBytes)) /
+        bytesPerCell);
+  }
+  return report;
+}
+
+void MemoryTelemetry::logReport() const {
+  const Report report = getReport();
+  _log.console("{ MEM }", report.budgetSupported
+                              ? "device memory budget"
+                              : "device memory, no VK_EXT_memory_budget");
+  for (size_t i = 0; i < report.heaps.size(); i++) {
+    const Heap& heap = report.heaps[i];
+    _log.console(_log.style.charLeader, "heap", i,
+                 heap.deviceLocal ? "device local," : "host,", heap.usage,
+                 "of", heap.budget, "bytes used, heap of", heap.size);
+  }
+
+  const auto& usage = report.usageBytes;
+  _log.console(_log.style.charLeader,
+               usage[static_cast<size_t>(Allocator::Usage::simulation)],
+               "bytes simulation buffers,",
+               usage[static_cast<size_t>(Allocator::Usage::uniforms)],
+               "uniform buffers,",
+               usage[static_cast<size_t>(Allocator::Usage::parameters)],
+               "generation parameters,",
+               usage[static_cast<size_t>(Allocator::Usage::attachments)],
+               "MSAA and depth attachments,");
+  _log.console(_log.style.charLeader,
+               usage[static_cast<size_t>(Allocator::Usage::staging)],
+               "bytes staging and readback buffers,",
+               usage[static_cast<size_t>(Allocator::Usage::cpuMirror)],
+               "CPU backend mirrors, about", report.swapChainBytes,
+               "swap chain images");
+  _log.console(_log.style.charLeader, report.host.liveBytes, "bytes in",
+               report.host.liveCount, "driver host allocations, peak",
+               report.host.peakBytes, "and", report.host.internalBytes,
+               "internal");
+  if (report.cellCapacity > 0) {
+    _log.console(_log.style.charLeader, "the budget holds grids of about",
+                 report.cellCapacity, "cells, this one has",
+                 _control.grid.dimensions[0] * _control.grid.dimensions[1]);
+  }
+}
+
+VKAPI_ATTR void* VKAPI_CALL
+MemoryTelemetry::allocate(void* userData,
+                          size_t size,
+                          size_t alignment,
+                          VkSystemAllocationScope scope) {
+  alignment = std::max(alignment, alignof(Header));
+  void* block = std::malloc(size + sizeof(Header) + alignment);
+  if (block == nullptr) {
+    return nullptr;
+  }
+  const uintptr_t start = reinterpret_cast<uintptr_t>(block) + sizeof(Header);
+  void* memory =
+      reinterpret_cast<void*>((start + alignment - 1) / alignment * alignment);
+  getHeader(memory) = {.size = size, .block = block};
+
+  HostCounters& counters =
+      static_cast<MemoryTelemetry*>(userData)->hostCounters;
+  const uint64_t liveBytes = counters.liveBytes += size;
+  counters.liveCount++;
+  uint64_t peakBytes = counters.peakBytes;
+  while (peakBytes < liveBytes &&
+         !counters.peakBytes.compare_exchange_weak(peakBytes, liveBytes)) {
+  }
+  return memory;
+}
+
+VKAPI_ATTR void* VKAPI_CALL
+MemoryTelemetry::reallocate(void* userData,
+                            void* original,
+                            size_t size,
+                            size_t alignment,
+                            VkSystemAllocationScope scope) {
+  if (original == nullptr) {
+    return allocate(userData, size, alignment, scope);
+  }
+  if (size == 0) {
+    free(userData, original);
+    return nullptr;
+  }
+  void* memory = allocate(userData, size, alignment, scope);
+  if (memory != nullptr) {
+    std::memcpy(memory, original, std::min(size, getHeader(original).size));
+    free(userData, original);
+  }
+  return memory;
+}
+
+VKAPI_ATTR void VKAPI_CALL MemoryTelemetry::free(void* userData,
+                                                  void* memory) {
+  if (memory == nullptr) {
+    return;
+  }
+  const Header header = getHeader(memory);
+  HostCounters& counters =
+      static_cast<MemoryTelemetry*>(userData)->hostCounters;
+  counters.liveBytes -= header.size;
+  counters.liveCount--;
+  std::free(header.block);
+}
+
+VKAPI_ATTR void VKAPI_CALL
+MemoryTelemetry::notifyInternalAllocation(void* userData,
+                                          size_t size,
+                                          VkInternalAllocationType type,
+                                          VkSystemAllocationScope scope) {
+  static_cast<MemoryTelemetry*>(userData)->hostCounters.internalBytes += size;
+}
+
+VKAPI_ATTR void VKAPI_CALL
+MemoryTelemetry::notifyInternalFree(void* userData,
+                                    size_t size,
+                                    VkInternalAllocationType type,
+                                    VkSystemAllocationScope scope) {
+  static_cast<MemoryTelemetry*>(userData)->hostCounters.internalBytes -= size;
+}
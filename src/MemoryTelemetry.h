@@ -0,0 +1,91 @@
+#pragma once
+
+#include "vulkan/vulkan.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "Allocator.h"
+
+// Where memory goes as the grid grows. Device memory is counted by what it
+// holds as the Allocator hands it out and set against the heap budgets of
+// VK_EXT_memory_budget, which include what other processes use, or against
+// the heap sizes without it. Host memory the driver allocates for the
+// instance, the device and device memory is counted through
+// VkAllocationCallbacks. Logged after initialization and with M, getReport
+// reads it any time.
+class MemoryTelemetry {
+ public:
+  MemoryTelemetry();
+  ~MemoryTelemetry();
+
+  struct Heap {
+    VkDeviceSize size;
+    // The heap size, and the Allocator's blocks in it, without the extension
+    VkDeviceSize budget;
+    VkDeviceSize usage;
+    bool deviceLocal;
+  };
+
+  struct HostAllocations {
+    uint64_t liveBytes;
+    uint64_t peakBytes;
+    uint64_t liveCount;
+    // Executable memory the driver allocates itself and only reports
+    uint64_t internalBytes;
+  };
+
+  struct Report {
+    bool budgetSupported;
+    std::vector<Heap> heaps;
+    std::array<VkDeviceSize, Allocator::usageCount> usageBytes;
+    // Allocated by the presentation engine, estimated at 4 bytes per pixel
+    VkDeviceSize swapChainBytes;
+    HostAllocations host;
+    // Cells the budget of the largest device local heap holds at the
+    // current simulation bytes per cell, 0 before any are allocated
+    uint64_t cellCapacity;
+  };
+
+ public:
+  bool checkBudgetSupport(VkPhysicalDevice physicalDevice);
+  const VkAllocationCallbacks* getCallbacks() const;
+  Report getReport() const;
+  void logReport() const;
+
+ private:
+  // Counted from any thread the driver allocates on
+  struct HostCounters {
+    std::atomic<uint64_t> liveBytes{0};
+    std::atomic<uint64_t> peakBytes{0};
+    std::atomic<uint64_t> liveCount{0};
+    std::atomic<uint64_t> internalBytes{0};
+  };
+
+  bool budgetSupported;
+  HostCounters hostCounters;
+  VkAllocationCallbacks callbacks;
+
+  static VKAPI_ATTR void* VKAPI_CALL allocate(void* userData,
+                                              size_t size,
+                                              size_t alignment,
+                                              VkSystemAllocationScope scope);
+  static VKAPI_ATTR void* VKAPI_CALL reallocate(void* userData,
+                                                void* original,
+                                                size_t size,
+                                                size_t alignment,
+                                                VkSystemAllocationScope scope);
+  static VKAPI_ATTR void VKAPI_CALL free(void* userData, void* memory);
+  static VKAPI_ATTR void VKAPI_CALL notifyInternalAllocation(
+      void* userData,
+      size_t size,
+      VkInternalAllocationType type,
+      VkSystemAllocationScope scope);
+  static VKAPI_ATTR void VKAPI_CALL notifyInternalFree(
+      void* userData,
+      size_t size,
+      VkInternalAllocationType type,
+      VkSystemAllocationScope scope);
+};
@@ -0,0 +1,652 @@
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+
+#include "CapitalEngine.h"
+#include "Pattern.h"
+
+namespace {
+// Next integer from position on, skipping whatever comes before it
+bool parseInteger(const char*& position, const char* end, int64_t& value) {
+  while (position < end) {
+    if ((*position >= '0' && *position <= '9') || *position == '-') {
+      const std::from_chars_result result =
+          std::from_chars(position, end, value);
+      if (result.ec == std::errc{}) {
+        position = result.ptr;
+        return true;
+      }
+    }
+    position++;
+  }
+  return false;
+}
+
+// Multi-state RLE tags p to y prefix the state letter that follows them
+bool isRunLengthTag(char c) {
+  return c == '.' || ((c >= 'a' && c <= 'z') && !(c >= 'p' && c <= 'y')) ||
+         (c >= 'A' && c <= 'Z');
+}
+}  // namespace
+
+Pattern::Pattern() : format{Format::rle}, originX{0}, originY{0} {
+  _log.console("{ PAT }", "constructing Pattern");
+}
+
+Pattern::~Pattern() {
+  _log.console("{ PAT }", "destructing Pattern");
+}
+
+// Maps the file and indexes its chunks, the mapping stays open until the
+// cells were loaded
+void Pattern::open(const std::string& path) {
+  static const char* formatNames[] = {"RLE", "Life 1.06", "plaintext",
+                                      "Macrocell"};
+  _log.console("{ PAT }", "opening pattern", path);
+  file.openForReading(path);
+  threadPool = std::make_unique<ThreadPool>(
+      std::max(std::thread::hardware_concurrency(), 1u));
+
+  splitChunks(readHeader(path));
+  switch (format) {
+    case Format::rle:
+      indexRunLength();
+      break;
+    case Format::life106:
+      indexLife106();
+      break;
+    case Format::plaintext:
+      indexPlaintext();
+      break;
+    case Format::macrocell:
+      indexMacrocell();
+      break;
+  }
+  _log.console(_log.style.charLeader, formatNames[static_cast<int>(format)],
+               "in", chunks.size(), "chunks,", threadPool->getThreadCount(),
+               "threads");
+}
+
+bool Pattern::isOpen() const {
+  return file.data != nullptr;
+}
+
+void Pattern::close() {
+  file.close(file.size);
+  chunks.clear();
+  nodes.clear();
+  threadPool.reset();
+}
+
+// Sets the alive cells of grid rows [firstRow, firstRow + rowCount) in words,
+// which the caller cleared. Chunks decode in parallel and may share words.
+void Pattern::decodeRows(uint32_t firstRow, uint32_t rowCount,
+                         uint32_t* words) {
+  const int64_t first = int64_t{firstRow} - originY;
+  const int64_t end = first + rowCount;
+
+  if (format == Format::macrocell) {
+    if (nodes.size() < 2) {
+      return;
+    }
+    const size_t wordsPerRow = (_control.grid.dimensions[0] + 31) / 32;
+    const uint32_t stripes =
+        std::min(threadPool->getThreadCount() * 4, rowCount);
+    threadPool->parallelFor(stripes, [&](uint32_t stripe) {
+      const int64_t begin = first + int64_t{rowCount} * stripe / stripes;
+      decodeNode(static_cast<uint32_t>(nodes.size() - 1), 0, 0, begin,
+                 first + int64_t{rowCount} * (stripe + 1) / stripes,
+                 words + static_cast<size_t>(begin - first) * wordsPerRow);
+    });
+    return;
+  }
+
+  std::vector<uint32_t> overlapping;
+  for (uint32_t i = 0; i < chunks.size(); i++) {
+    if (chunks[i].firstRow < chunks[i].endRow && chunks[i].firstRow < end &&
+        chunks[i].endRow > first) {
+      overlapping.push_back(i);
+    }
+  }
+  threadPool->parallelFor(
+      static_cast<uint32_t>(overlapping.size()), [&](uint32_t i) {
+        const Chunk& chunk = chunks[overlapping[i]];
+        if (format == Format::rle) {
+          decodeRunLength(chunk, first, end, words);
+        } else if (format == Format::life106) {
+          decodeLife106(chunk, first, end, words);
+        } else {
+          decodePlaintext(chunk, first, end, words);
+        }
+      });
+}
+
+// For the CPU backend, which keeps a host copy of the grid anyway
+std::vector<World::Cell> Pattern::readCells() {
+  const uint32_t width = static_cast<uint32_t>(_control.grid.dimensions[0]);
+  const uint32_t height = static_cast<uint32_t>(_control.grid.dimensions[1]);
+  const uint32_t wordsPerRow = (width + 31) / 32;
+
+  std::vector<uint32_t> words(static_cast<size_t>(wordsPerRow) * height, 0);
+  decodeRows(0, height, words.data());
+
+  std::vector<World::Cell> cells(static_cast<size_t>(width) * height);
+  for (uint32_t y = 0; y < height; y++) {
+    for (uint32_t x = 0; x < width; x++) {
+      cells[static_cast<size_t>(y) * width + x].state =
+          (words[static_cast<size_t>(y) * wordsPerRow + x / 32] >> (x % 32)) &
+          1u;
+    }
+  }
+  return cells;
+}
+
+// Tells the format from the first line, or the extension of plaintext files
+// without comments. Returns where the cells start.
+size_t Pattern::readHeader(const std::string& path) {
+  size_t position = 0;
+  size_t length = 0;
+  const char* line = getLine(position, file.size, length);
+  const std::string_view first(line, length);
+  if (first.starts_with("[M2]")) {
+    format = Format::macrocell;
+    return position;
+  }
+  if (first.starts_with("#Life 1.06")) {
+    format = Format::life106;
+    return position;
+  }
+  if (first.starts_with("!") || path.ends_with(".cells")) {
+    format = Format::plaintext;
+    return 0;
+  }
+
+  // RLE: comment lines, then x = <width>, y = <height>[, rule = <rule>]
+  format = Format::rle;
+  position = 0;
+  while (position < file.size) {
+    line = getLine(position, file.size, length);
+    const char* lineEnd = line + length;
+    while (line < lineEnd && (*line == ' ' || *line == '\t')) {
+      line++;
+    }
+    if (line == lineEnd || *line == '#') {
+      continue;
+    }
+    int64_t width = 0;
+    int64_t height = 0;
+    if (*line != 'x' || !parseInteger(line, lineEnd, width) ||
+        !parseInteger(line, lineEnd, height)) {
+      break;
+    }
+    place(0, 0, width - 1, height - 1);
+    return position;
+  }
+  throw std::runtime_error("\n!ERROR! Unknown pattern format: " + path);
+}
+
+// Roughly chunkSize bytes each, ending after a line break
+void Pattern::splitChunks(size_t dataBegin) {
+  const size_t count = std::max<size_t>((file.size - dataBegin) / chunkSize, 1);
+  const char* data = reinterpret_cast<const char*>(file.data);
+  chunks.assign(count, Chunk{});
+
+  size_t begin = dataBegin;
+  for (size_t i = 0; i < count; i++) {
+    size_t end = dataBegin + (file.size - dataBegin) * (i + 1) / count;
+    end = std::max(end, begin);
+    if (end > 0 && end < file.size && data[end - 1] != '\n') {
+      const void* lineBreak = std::memchr(data + end, '\n', file.size - end);
+      end = lineBreak == nullptr
+                ? file.size
+                : static_cast<size_t>(static_cast<const char*>(lineBreak) -
+                                      data) +
+                      1;
+    }
+    chunks[i].begin = begin;
+    chunks[i].end = end;
+    begin = end;
+  }
+}
+
+// Each chunk is walked on its own for the rows and columns it advances, a
+// prefix sum over the chunks then gives where each starts
+void Pattern::indexRunLength() {
+  struct Walk {
+    int64_t rows{0};
+    int64_t x{0};
+    bool newRow{false};
+    bool ended{false};
+  };
+  std::vector<Walk> walks(chunks.size());
+  const char* data = reinterpret_cast<const char*>(file.data);
+
+  threadPool->parallelFor(
+      static_cast<uint32_t>(chunks.size()), [&](uint32_t i) {
+        Walk& walk = walks[i];
+        int64_t count = 0;
+        for (size_t p = chunks[i].begin; p < chunks[i].end; p++) {
+          const char c = data[p];
+          if (c >= '0' && c <= '9') {
+            count = count * 10 + (c - '0');
+          } else if (c == '$') {
+            walk.rows += std::max<int64_t>(count, 1);
+            walk.x = 0;
+            walk.newRow = true;
+            count = 0;
+          } else if (c == '!') {
+            walk.ended = true;
+            break;
+          } else if (isRunLengthTag(c)) {
+            walk.x += std::max<int64_t>(count, 1);
+            count = 0;
+          }
+        }
+      });
+
+  int64_t x = 0;
+  int64_t y = 0;
+  bool ended = false;
+  for (size_t i = 0; i < chunks.size(); i++) {
+    Chunk& chunk = chunks[i];
+    chunk.x = x;
+    chunk.y = y;
+    chunk.firstRow = y;
+    if (ended) {
+      chunk.endRow = y;
+      continue;
+    }
+    y += walks[i].rows;
+    x = walks[i].newRow ? walks[i].x : x + walks[i].x;
+    chunk.endRow = y + 1;
+    ended = walks[i].ended;
+  }
+}
+
+void Pattern::indexLife106() {
+  struct Box {
+    int64_t minX{INT64_MAX};
+    int64_t maxX{INT64_MIN};
+  };
+  std::vector<Box> boxes(chunks.size());
+
+  threadPool->parallelFor(
+      static_cast<uint32_t>(chunks.size()), [&](uint32_t i) {
+        Chunk& chunk = chunks[i];
+        int64_t minY = INT64_MAX;
+        int64_t maxY = INT64_MIN;
+        size_t position = chunk.begin;
+        size_t length = 0;
+        while (position < chunk.end) {
+          const char* line = getLine(position, chunk.end, length);
+          const char* lineEnd = line + length;
+          int64_t x = 0;
+          int64_t y = 0;
+          if (length == 0 || *line == '#' ||
+              !parseInteger(line, lineEnd, x) ||
+              !parseInteger(line, lineEnd, y)) {
+            continue;
+          }
+          boxes[i].minX = std::min(boxes[i].minX, x);
+          boxes[i].maxX = std::max(boxes[i].maxX, x);
+          minY = std::min(minY, y);
+          maxY = std::max(maxY, y);
+        }
+        chunk.firstRow = minY == INT64_MAX ? 0 : minY;
+        chunk.endRow = minY == INT64_MAX ? 0 : maxY + 1;
+      });
+
+  Box box;
+  int64_t minY = INT64_MAX;
+  int64_t maxY = INT64_MIN;
+  for (size_t i = 0; i < chunks.size(); i++) {
+    if (chunks[i].firstRow < chunks[i].endRow) {
+      box.minX = std::min(box.minX, boxes[i].minX);
+      box.maxX = std::max(box.maxX, boxes[i].maxX);
+      minY = std::min(minY, chunks[i].firstRow);
+      maxY = std::max(maxY, chunks[i].endRow - 1);
+    }
+  }
+  if (minY == INT64_MAX) {
+    place(0, 0, -1, -1);
+  } else {
+    place(box.minX, minY, box.maxX, maxY);
+  }
+}
+
+// Every line not starting with ! is a row
+void Pattern::indexPlaintext() {
+  std::vector<int64_t> widths(chunks.size(), 0);
+
+  threadPool->parallelFor(
+      static_cast<uint32_t>(chunks.size()), [&](uint32_t i) {
+        Chunk& chunk = chunks[i];
+        size_t position = chunk.begin;
+        size_t length = 0;
+        while (position < chunk.end) {
+          const char* line = getLine(position, chunk.end, length);
+          if (length > 0 && *line == '!') {
+            continue;
+          }
+          widths[i] = std::max(widths[i], static_cast<int64_t>(length));
+          chunk.endRow++;
+        }
+      });
+
+  int64_t rows = 0;
+  int64_t width = 0;
+  for (size_t i = 0; i < chunks.size(); i++) {
+    const int64_t chunkRows = chunks[i].endRow;
+    chunks[i].y = rows;
+    chunks[i].firstRow = rows;
+    chunks[i].endRow = rows + chunkRows;
+    rows += chunkRows;
+    width = std::max(width, widths[i]);
+  }
+  place(0, 0, width - 1, rows - 1);
+}
+
+// Node lines are numbered from 1 in file order, children come before their
+// parents and the last node is the root. The chunks count their nodes, then
+// parse them in parallel, the boxes follow in one pass in file order.
+void Pattern::indexMacrocell() {
+  auto isNode = [](const char* line, size_t length) {
+    return length > 0 && *line != '#' && *line != '[';
+  };
+
+  threadPool->parallelFor(
+      static_cast<uint32_t>(chunks.size()), [&](uint32_t i) {
+        size_t position = chunks[i].begin;
+        size_t length = 0;
+        while (position < chunks[i].end) {
+          const char* line = getLine(position, chunks[i].end, length);
+          chunks[i].firstNode += isNode(line, length);
+        }
+      });
+  uint32_t nodeCount = 0;
+  for (Chunk& chunk : chunks) {
+    const uint32_t chunkNodes = chunk.firstNode;
+    chunk.firstNode = nodeCount + 1;
+    nodeCount += chunkNodes;
+  }
+  nodes.assign(nodeCount + 1, Node{});
+
+  std::atomic<bool> corrupt{false};
+  threadPool->parallelFor(
+      static_cast<uint32_t>(chunks.size()), [&](uint32_t i) {
+        uint32_t id = chunks[i].firstNode;
+        size_t position = chunks[i].begin;
+        size_t length = 0;
+        while (position < chunks[i].end) {
+          const char* line = getLine(position, chunks[i].end, length);
+          if (!isNode(line, length)) {
+            continue;
+          }
+          Node& node = nodes[id];
+          if (*line == '.' || *line == '*' || *line == '$') {
+            node.level = 3;
+            uint32_t x = 0;
+            uint32_t y = 0;
+            for (size_t c = 0; c < length; c++) {
+              if (line[c] == '$') {
+                x = 0;
+                y++;
+              } else if (line[c] == '*' && x < 8 && y < 8) {
+                node.leaf |= uint64_t{1} << (y * 8 + x++);
+              } else {
+                x++;
+              }
+            }
+          } else {
+            const char* lineEnd = line + length;
+            int64_t values[5];
+            for (int64_t& value : values) {
+              if (!parseInteger(line, lineEnd, value)) {
+                corrupt = true;
+              }
+            }
+            node.level = static_cast<uint32_t>(values[0]);
+            for (size_t q = 0; q < 4; q++) {
+              if (values[q + 1] < 0 || values[q + 1] >= id) {
+                corrupt = true;
+              }
+              node.children[q] = static_cast<uint32_t>(values[q + 1]);
+            }
+          }
+          id++;
+        }
+      });
+
+  for (uint32_t id = 1; id < nodes.size() && !corrupt; id++) {
+    Node& node = nodes[id];
+    if (node.level == 3) {
+      if (node.leaf == 0) {
+        continue;
+      }
+      node.minX = 7;
+      node.minY = 7;
+      for (int64_t bit = 0; bit < 64; bit++) {
+        if ((node.leaf >> bit) & 1u) {
+          node.minX = std::min(node.minX, bit % 8);
+          node.minY = std::min(node.minY, bit / 8);
+          node.maxX = std::max(node.maxX, bit % 8);
+          node.maxY = std::max(node.maxY, bit / 8);
+        }
+      }
+      continue;
+    }
+    if (node.level < 4 || node.level > 62) {
+      corrupt = true;
+      break;
+    }
+    const int64_t half = int64_t{1} << (node.level - 1);
+    bool empty = true;
+    for (size_t q = 0; q < 4; q++) {
+      const Node& child = nodes[node.children[q]];
+      if (node.children[q] == 0 || child.minX > child.maxX) {
+        continue;
+      }
+      if (child.level != node.level - 1) {
+        corrupt = true;
+        break;
+      }
+      const int64_t x = static_cast<int64_t>(q & 1) * half;
+      const int64_t y = static_cast<int64_t>(q >> 1) * half;
+      node.minX = empty ? x + child.minX : std::min(node.minX, x + child.minX);
+      node.minY = empty ? y + child.minY : std::min(node.minY, y + child.minY);
+      node.maxX = empty ? x + child.maxX : std::max(node.maxX, x + child.maxX);
+      node.maxY = empty ? y + child.maxY : std::max(node.maxY, y + child.maxY);
+      empty = false;
+    }
+  }
+  if (corrupt) {
+    throw std::runtime_error("\n!ERROR! Corrupt Macrocell pattern");
+  }
+
+  if (nodeCount == 0) {
+    place(0, 0, -1, -1);
+    return;
+  }
+  const Node& root = nodes.back();
+  place(root.minX, root.minY, root.maxX, root.maxY);
+}
+
+// Centres the box of alive cells on the grid
+void Pattern::place(int64_t minX, int64_t minY, int64_t maxX, int64_t maxY) {
+  const int64_t width = std::max<int64_t>(maxX - minX + 1, 0);
+  const int64_t height = std::max<int64_t>(maxY - minY + 1, 0);
+  const int64_t gridWidth = _control.grid.dimensions[0];
+  const int64_t gridHeight = _control.grid.dimensions[1];
+  if (width > gridWidth || height > gridHeight) {
+    throw std::runtime_error("\n!ERROR! Pattern of " + std::to_string(width) +
+                             "x" + std::to_string(height) +
+                             " does not fit the grid, see --grid");
+  }
+  originX = (gridWidth - width) / 2 - (width > 0 ? minX : 0);
+  originY = (gridHeight - height) / 2 - (height > 0 ? minY : 0);
+  _log.console(_log.style.charLeader, "pattern of", width, "x", height,
+               "cells");
+}
+
+void Pattern::decodeRunLength(const Chunk& chunk,
+                              int64_t firstRow,
+                              int64_t endRow,
+                              uint32_t* words) const {
+  const char* data = reinterpret_cast<const char*>(file.data);
+  int64_t x = chunk.x;
+  int64_t y = chunk.y;
+  int64_t count = 0;
+  for (size_t p = chunk.begin; p < chunk.end; p++) {
+    const char c = data[p];
+    if (c >= '0' && c <= '9') {
+      count = count * 10 + (c - '0');
+    } else if (c == '$') {
+      y += std::max<int64_t>(count, 1);
+      x = 0;
+      count = 0;
+      if (y >= endRow) {
+        return;
+      }
+    } else if (c == '!') {
+      return;
+    } else if (isRunLengthTag(c)) {
+      const int64_t run = std::max<int64_t>(count, 1);
+      if (c != 'b' && c != '.' && y >= firstRow) {
+        setCells(x, y, run, firstRow, words);
+      }
+      x += run;
+      count = 0;
+    }
+  }
+}
+
+void Pattern::decodeLife106(const Chunk& chunk,
+                            int64_t firstRow,
+                            int64_t endRow,
+                            uint32_t* words) const {
+  size_t position = chunk.begin;
+  size_t length = 0;
+  while (position < chunk.end) {
+    const char* line = getLine(position, chunk.end, length);
+    const char* lineEnd = line + length;
+    int64_t x = 0;
+    int64_t y = 0;
+    if (length == 0 || *line == '#' || !parseInteger(line, lineEnd, x) ||
+        !parseInteger(line, lineEnd, y)) {
+      continue;
+    }
+    if (y >= firstRow && y < endRow) {
+      setCells(x, y, 1, firstRow, words);
+    }
+  }
+}
+
+void Pattern::decodePlaintext(const Chunk& chunk,
+                              int64_t firstRow,
+                              int64_t endRow,
+                              uint32_t* words) const {
+  int64_t y = chunk.y;
+  size_t position = chunk.begin;
+  size_t length = 0;
+  while (position < chunk.end && y < endRow) {
+    const char* line = getLine(position, chunk.end, length);
+    if (length > 0 && *line == '!') {
+      continue;
+    }
+    if (y >= firstRow) {
+      size_t x = 0;
+      while (x < length) {
+        const size_t begin = x;
+        while (x < length && (line[x] == 'O' || line[x] == '*')) {
+          x++;
+        }
+        if (x > begin) {
+          setCells(static_cast<int64_t>(begin), y,
+                   static_cast<int64_t>(x - begin), firstRow, words);
+        }
+        x++;
+      }
+    }
+    y++;
+  }
+}
+
+// Cells of the node with its corner at pattern position x, y that fall into
+// rows [firstRow, endRow), skipping empty nodes and those outside the rows
+void Pattern::decodeNode(uint32_t node,
+                         int64_t x,
+                         int64_t y,
+                         int64_t firstRow,
+                         int64_t endRow,
+                         uint32_t* words) const {
+  const Node& current = nodes[node];
+  if (node == 0 || current.minX > current.maxX ||
+      y + current.maxY < firstRow || y + current.minY >= endRow) {
+    return;
+  }
+  if (current.level == 3) {
+    for (int64_t row = 0; row < 8; row++) {
+      if (y + row < firstRow || y + row >= endRow) {
+        continue;
+      }
+      const uint32_t bits = (current.leaf >> (row * 8)) & 0xFFu;
+      for (int64_t column = 0; column < 8; column++) {
+        if ((bits >> column) & 1u) {
+          setCells(x + column, y + row, 1, firstRow, words);
+        }
+      }
+    }
+    return;
+  }
+  const int64_t half = int64_t{1} << (current.level - 1);
+  for (uint32_t q = 0; q < 4; q++) {
+    decodeNode(current.children[q], x + (q & 1) * half, y + (q >> 1) * half,
+               firstRow, endRow, words);
+  }
+}
+
+// Count cells from pattern position x in the row, clipped to the grid. Runs
+// of different chunks may end in the same word.
+void Pattern::setCells(int64_t x,
+                       int64_t row,
+                       int64_t count,
+                       int64_t firstRow,
+                       uint32_t* words) const {
+  const int64_t width = _control.grid.dimensions[0];
+  const size_t wordsPerRow = static_cast<size_t>(width + 31) / 32;
+  uint32_t* rowWords =
+      words + static_cast<size_t>(row - firstRow) * wordsPerRow;
+
+  int64_t begin = std::max<int64_t>(originX + x, 0);
+  const int64_t end = std::min(originX + x + count, width);
+  while (begin < end) {
+    const int64_t wordEnd = std::min(end, (begin / 32 + 1) * 32);
+    const uint32_t bits = static_cast<uint32_t>(wordEnd - begin);
+    const uint32_t mask = (bits == 32 ? ~0u : (1u << bits) - 1u)
+                          << (begin % 32);
+    std::atomic_ref<uint32_t>(rowWords[begin / 32])
+        .fetch_or(mask, std::memory_order_relaxed);
+    begin = wordEnd;
+  }
+}
+
+// The line from position on without its line break, position moves past it
+const char* Pattern::getLine(size_t& position,
+                             size_t end,
+                             size_t& length) const {
+  const char* line = reinterpret_cast<const char*>(file.data) + position;
+  const void* lineBreak = std::memchr(line, '\n', end - position);
+  length = lineBreak == nullptr
+               ? end - position
+               : static_cast<size_t>(static_cast<const char*>(lineBreak) -
+                                     line);
+  position += lineBreak == nullptr ? length : length + 1;
+  if (length > 0 && line[length - 1] == '\r') {
+    length--;
+  }
+  return line;
+}
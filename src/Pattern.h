@@ -0,0 +1,105 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+#include "ThreadPool.h"
+#include "World.h"
+
+// Starting patterns from RLE, Life 1.06, plaintext and Macrocell files. The
+// file is mapped and split into chunks of whole lines, which worker threads
+// index in parallel: where in the pattern each chunk starts and which rows it
+// touches, or which Macrocell nodes it holds. decodeRows then sets the alive
+// cells of a band of grid rows, 32 cells per word as in the packed backend,
+// straight into the caller's memory, usually a mapped staging buffer, so the
+// pattern is never held as cells. The pattern is centred on the grid. Rules
+// the files name are ignored, see --rule.
+class Pattern {
+ public:
+  Pattern();
+  ~Pattern();
+
+  enum class Format { rle, life106, plaintext, macrocell };
+
+ public:
+  void open(const std::string& path);
+  bool isOpen() const;
+  void close();
+  void decodeRows(uint32_t firstRow, uint32_t rowCount, uint32_t* words);
+  std::vector<World::Cell> readCells();
+
+ private:
+  inline static const size_t chunkSize{size_t{1} << 20};
+
+  // Bytes [begin, end) of the file. Pattern position the chunk starts at and
+  // its rows [firstRow, endRow), or the number of its first Macrocell node.
+  struct Chunk {
+    size_t begin{0};
+    size_t end{0};
+    int64_t x{0};
+    int64_t y{0};
+    int64_t firstRow{0};
+    int64_t endRow{0};
+    uint32_t firstNode{0};
+  };
+
+  // A Macrocell leaf is an 8x8 block at level 3, row y in byte y. Nodes above
+  // have four quadrants, node 0 being empty. The box of alive cells is
+  // relative to the node's corner, empty while minX > maxX.
+  struct Node {
+    uint32_t level{0};
+    std::array<uint32_t, 4> children{};
+    uint64_t leaf{0};
+    int64_t minX{1};
+    int64_t minY{1};
+    int64_t maxX{0};
+    int64_t maxY{0};
+  };
+
+  MappedFile file;
+  Format format;
+  std::vector<Chunk> chunks;
+  std::vector<Node> nodes;
+  std::unique_ptr<ThreadPool> threadPool;
+  // Grid position of pattern position (0, 0)
+  int64_t originX;
+  int64_t originY;
+
+  size_t readHeader(const std::string& path);
+  void splitChunks(size_t dataBegin);
+  void indexRunLength();
+  void indexLife106();
+  void indexPlaintext();
+  void indexMacrocell();
+  void place(int64_t minX, int64_t minY, int64_t maxX, int64_t maxY);
+
+  void decodeRunLength(const Chunk& chunk,
+                       int64_t firstRow,
+                       int64_t endRow,
+                       uint32_t* words) const;
+  void decodeLife106(const Chunk& chunk,
+                     int64_t firstRow,
+                     int64_t endRow,
+                     uint32_t* words) const;
+  void decodePlaintext(const Chunk& chunk,
+                       int64_t firstRow,
+                       int64_t endRow,
+                       uint32_t* words) const;
+  void decodeNode(uint32_t node,
+                  int64_t x,
+                  int64_t y,
+                  int64_t firstRow,
+                  int64_t endRow,
+                  uint32_t* words) const;
+  void setCells(int64_t x,
+                int64_t row,
+                int64_t count,
+                int64_t firstRow,
+                uint32_t* words) const;
+
+  const char* getLine(size_t& position, size_t end, size_t& length) const;
+};
@@ -231,7 +231,7 @@ bool Pipelines::hasStencilComponent(VkFormat format) {
 VkPipelineShaderStageCreateInfo Pipelines::getShaderStageInfo(
     VkShaderStageFlagBits shaderStage,
     std::string shaderName,
-    auto pipeline) {
+    auto& pipeline) {
   std::string directory = "shaders/";
   std::string shaderPath = directory + shaderName;
 
@@ -269,9 +269,6 @@ std::vector<char> Pipelines::readShaderFile(const std::string& filename) {
 void Pipelines::createComputePipeline() {
   _log.console("{ PIP }", "creating Compute Pipeline");
 
-  VkPipelineShaderStageCreateInfo computeShaderStageInfo =
-      getShaderStageInfo(VK_SHADER_STAGE_COMPUTE_BIT, "comp.spv", compute);
-
   VkPushConstantRange pushConstantRange = {
       .stageFlags = _memory.pushConstants.shaderStage,
       .offset = _memory.pushConstants.offset,
@@ -287,16 +284,116 @@ void Pipelines::createComputePipeline() {
   _mechanics.result(vkCreatePipelineLayout, _mechanics.mainDevice.logical,
                     &pipelineLayoutInfo, nullptr, &compute.pipelineLayout);
 
+  VkPipelineCacheCreateInfo cacheInfo{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO};
+  _mechanics.result(vkCreatePipelineCache, _mechanics.mainDevice.logical,
+                    &cacheInfo, nullptr, &compute.cache);
+
+  for (const Control::Rule& rule : _control.rules.available) {
+    const std::string& key = rule.name;
+    if (compute.rulePipelines.contains(key)) {
+      continue;
+    }
+    _log.console(_log.style.charLeader, "building rule", rule.name);
+    compute.rulePipelines[key] = {
+        .pipeline = createComputeShaderPipeline("comp.spv", rule),
+        .packedPipeline = createComputeShaderPipeline("packed.comp.spv", rule),
+        .columnsPipeline = VK_NULL_HANDLE,
+        .rowsPipeline = VK_NULL_HANDLE};
+    if (rule.radius > 1) {
+      compute.rulePipelines[key].columnsPipeline =
+          createComputeShaderPipeline("rangeColumns.comp.spv", rule);
+      compute.rulePipelines[key].rowsPipeline =
+          createComputeShaderPipeline("rangeRows.comp.spv", rule);
+    }
+  }
+
+  _log.console("{ PIP }", "creating Packed Compute Pipelines");
+  compute.expandPipeline =
+      createComputeShaderPipeline("expand.comp.spv", _control.getRule());
+  compute.activityPipeline =
+      createComputeShaderPipeline("activity.comp.spv", _control.getRule());
+
+  _log.console("{ PIP }", "creating History Compute Pipelines");
+  compute.snapshotPipeline =
+      createComputeShaderPipeline("snapshot.comp.spv", _control.getRule());
+  compute.restorePipeline =
+      createComputeShaderPipeline("restore.comp.spv", _control.getRule());
+
+  _log.console("{ PIP }", "creating Recorder Compute Pipeline");
+  compute.deltaPipeline =
+      createComputeShaderPipeline("delta.comp.spv", _control.getRule());
+
+  _log.console("{ PIP }", "creating World Compute Pipeline");
+  compute.initializePipeline =
+      createComputeShaderPipeline("initialize.comp.spv", _control.getRule());
+
+  destroyShaderModules(compute.shaderModules);
+  selectRule(_control.getRule());
+}
+
+void Pipelines::selectRule(const Control::Rule& rule) {
+  const auto pipelines = compute.rulePipelines.find(rule.name);
+  if (pipelines == compute.rulePipelines.end()) {
+    throw std::runtime_error("\n!ERROR! No pipelines built for rule " +
+                             rule.name);
+  }
+  compute.pipeline = pipelines->second.pipeline;
+  compute.packedPipeline = pipelines->second.packedPipeline;
+  compute.columnsPipeline = pipelines->second.columnsPipeline;
+  compute.rowsPipeline = pipelines->second.rowsPipeline;
+}
+
+// Specialization constants 0 and 1 are the workgroup size, 2 to 9 the rule as
+// laid out in Control::Rule, 10 the run length of the Larger than Life sums
+// 11 to 13 the history as in Control::History, 14 whether shader.comp
+// collects Statistics and 15 and 16 the height steps and alive threshold
+// initialize.comp seeds the world with. Shaders without a constant ignore it.
+VkPipeline Pipelines::createComputeShaderPipeline(std::string shaderName,
+                                                  const Control::Rule& rule) {
+  VkPipelineShaderStageCreateInfo computeShaderStageInfo =
+      getShaderStageInfo(VK_SHADER_STAGE_COMPUTE_BIT, shaderName, compute);
+
+  const std::array<uint32_t, 17> constants{_control.compute.localSizeX,
+                                           _control.compute.localSizeY,
+                                           rule.birth,
+                                           rule.survival,
+                                           rule.radius,
+                                           rule.birthRange[0],
+                                           rule.birthRange[1],
+                                           rule.survivalRange[0],
+                                           rule.survivalRange[1],
+                                           rule.includeCenter,
+                                           _control.compute.runLength,
+                                           _control.history.length,
+                                           _control.history.keyframeInterval,
+                                           _control.history.keyframeCount,
+                                           _control.statistics.enabled,
+                                           static_cast<uint32_t>(
+                                               _control.grid.heightSteps),
+                                           _control.getAliveThreshold()};
+  std::array<VkSpecializationMapEntry, 17> specializationEntries;
+  for (uint32_t i = 0; i < specializationEntries.size(); i++) {
+    const uint32_t offset = i * sizeof(uint32_t);
+    specializationEntries[i] = {
+        .constantID = i, .offset = offset, .size = sizeof(uint32_t)};
+  }
+  VkSpecializationInfo specializationInfo{
+      .mapEntryCount = static_cast<uint32_t>(specializationEntries.size()),
+      .pMapEntries = specializationEntries.data(),
+      .dataSize = sizeof(constants),
+      .pData = constants.data()};
+  computeShaderStageInfo.pSpecializationInfo = &specializationInfo;
+
   VkComputePipelineCreateInfo pipelineInfo{
       .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
       .stage = computeShaderStageInfo,
       .layout = compute.pipelineLayout};
 
+  VkPipeline pipeline;
   _mechanics.result(vkCreateComputePipelines, _mechanics.mainDevice.logical,
-                    VK_NULL_HANDLE, 1, &pipelineInfo, nullptr,
-                    &compute.pipeline);
-
-  destroyShaderModules(compute.shaderModules);
+                    compute.cache, 1, &pipelineInfo, nullptr, &pipeline);
+  return pipeline;
 }
 
 VkSampleCountFlagBits Pipelines::getMaxUsableSampleCount() {
@@ -336,6 +433,7 @@ void Pipelines::destroyShaderModules(
     vkDestroyShaderModule(_mechanics.mainDevice.logical, shaderModules[i],
                           nullptr);
   }
+  shaderModules.clear();
 };
 
 VkPipelineVertexInputStateCreateInfo Pipelines::getVertexInputInfo() {
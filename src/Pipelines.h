@@ -2,6 +2,12 @@
 
 #include <glm/glm.hpp>
 
+#include <map>
+#include <string>
+
+#include "Allocator.h"
+#include "Control.h"
+
 class Pipelines {
  public:
   Pipelines();
@@ -16,22 +22,43 @@ class Pipelines {
 
     struct Depth {
       VkImage image;
-      VkDeviceMemory imageMemory;
+      Allocator::Allocation imageMemory;
       VkImageView imageView;
     } depth;
 
     struct MultiSampling {
       VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
       VkImage colorImage;
-      VkDeviceMemory colorImageMemory;
+      Allocator::Allocation colorImageMemory;
       VkImageView colorImageView;
     } msaa;
   } graphics;
 
   struct Compute {
     VkPipelineLayout pipelineLayout;
+    // Cell, packed and Larger than Life sum pipelines of the current rule
     VkPipeline pipeline;
+    VkPipeline packedPipeline;
+    VkPipeline columnsPipeline;
+    VkPipeline rowsPipeline;
+    VkPipeline expandPipeline;
+    VkPipeline activityPipeline;
+    VkPipeline snapshotPipeline;
+    VkPipeline restorePipeline;
+    VkPipeline deltaPipeline;
+    VkPipeline initializePipeline;
     std::vector<VkShaderModule> shaderModules;
+
+    // Built once for every rule in Control::rules, keyed by the canonical
+    // rule name, so switching rules only swaps the handles above
+    struct RulePipelines {
+      VkPipeline pipeline;
+      VkPipeline packedPipeline;
+      VkPipeline columnsPipeline;
+      VkPipeline rowsPipeline;
+    };
+    std::map<std::string, RulePipelines> rulePipelines;
+    VkPipelineCache cache;
   } compute;
 
  public:
@@ -42,6 +69,7 @@ class Pipelines {
 
   void createGraphicsPipeline();
   void createComputePipeline();
+  void selectRule(const Control::Rule& rule);
 
   VkSampleCountFlagBits getMaxUsableSampleCount();
 
@@ -58,7 +86,9 @@ class Pipelines {
   VkPipelineShaderStageCreateInfo getShaderStageInfo(
       VkShaderStageFlagBits shaderStage,
       std::string shaderName,
-      auto pipeline);
+      auto& pipeline);
+  VkPipeline createComputeShaderPipeline(std::string shaderName,
+                                         const Control::Rule& rule);
 
   VkPipelineVertexInputStateCreateInfo getVertexInputInfo();
   VkPipelineColorBlendStateCreateInfo getColorBlendingInfo();
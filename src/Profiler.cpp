@@ -0,0 +1,259 @@
+#include <algorithm>
+#include <numeric>
+
+#include "CapitalEngine.h"
+#include "Profiler.h"
+
+Profiler::Profiler()
+    : statistics{},
+      timestampsSupported{false},
+      statisticsSupported{false},
+      timestampPeriod{0.0},
+      timestampMasks{},
+      nextSample{},
+      frameCount{0} {
+  _log.console("{ PRO }", "constructing Profiler");
+}
+
+Profiler::~Profiler() {
+  _log.console("{ PRO }", "destructing Profiler");
+}
+
+void Profiler::createQueryPools() {
+  _log.console("{ PRO }", "creating Query Pools");
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(_mechanics.mainDevice.physical, &properties);
+  VkPhysicalDeviceFeatures features;
+  vkGetPhysicalDeviceFeatures(_mechanics.mainDevice.physical, &features);
+
+  timestampsSupported = properties.limits.timestampComputeAndGraphics;
+  statisticsSupported = features.pipelineStatisticsQuery;
+  timestampPeriod = properties.limits.timestampPeriod;
+  const VulkanMechanics::Queues::FamilyIndices& indices =
+      _mechanics.queues.familyIndices;
+  timestampMasks = {getTimestampMask(indices.computeFamily.value()),
+                    getTimestampMask(indices.graphicsAndComputeFamily.value())};
+  if (!timestampsSupported) {
+    _log.console(_log.style.charLeader, "timestamps unsupported, GPU passes",
+                 "are not timed");
+  }
+
+  frames.resize(MAX_FRAMES_IN_FLIGHT);
+  for (FrameQueries& queries : frames) {
+    if (timestampsSupported) {
+      VkQueryPoolCreateInfo timestampInfo{
+          .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+          .queryType = VK_QUERY_TYPE_TIMESTAMP,
+          .queryCount = static_cast<uint32_t>(gpuPassCount * 2)};
+      _mechanics.result(vkCreateQueryPool, _mechanics.mainDevice.logical,
+                        &timestampInfo, nullptr, &queries.timestamps);
+    }
+    for (size_t pass = 0; statisticsSupported && pass < gpuPassCount;
+         pass++) {
+      VkQueryPoolCreateInfo statisticsInfo{
+          .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+          .queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS,
+          .queryCount = 1,
+          .pipelineStatistics = pipelineStatistics[pass]};
+      _mechanics.result(vkCreateQueryPool, _mechanics.mainDevice.logical,
+                        &statisticsInfo, nullptr, &queries.statistics[pass]);
+    }
+  }
+
+  for (std::vector<double>& passSamples : samples) {
+    passSamples.reserve(windowSize);
+  }
+}
+
+void Profiler::destroyQueryPools() {
+  for (FrameQueries& queries : frames) {
+    vkDestroyQueryPool(_mechanics.mainDevice.logical, queries.timestamps,
+                       nullptr);
+    for (VkQueryPool statisticsPool : queries.statistics) {
+      vkDestroyQueryPool(_mechanics.mainDevice.logical, statisticsPool,
+                         nullptr);
+    }
+  }
+  frames.clear();
+}
+
+// Once the last submissions of this frame have been waited on, reads back the
+// queries they wrote
+void Profiler::collectResults() {
+  if (frames.empty()) {
+    return;
+  }
+  FrameQueries& queries = frames[_mechanics.syncObjects.currentFrame];
+  for (size_t pass = 0; pass < gpuPassCount; pass++) {
+    if (queries.written[pass]) {
+      readResults(queries, pass);
+    }
+  }
+}
+
+// Must be recorded outside a render pass. Command buffers recorded once may
+// be submitted any number of times, markSubmitted flags each submission. The
+// queries are reset here, so is their flag: results of an earlier submission
+// are not read as this one's.
+void Profiler::beginPass(VkCommandBuffer commandBuffer, Pass pass) {
+  if (frames.empty()) {
+    return;
+  }
+  const size_t index = static_cast<size_t>(pass);
+  FrameQueries& queries = frames[_mechanics.syncObjects.currentFrame];
+  queries.written[index] = false;
+
+  const uint32_t firstTimestamp = static_cast<uint32_t>(index * 2);
+  if (queries.timestamps != VK_NULL_HANDLE) {
+    vkCmdResetQueryPool(commandBuffer, queries.timestamps, firstTimestamp, 2);
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                        queries.timestamps, firstTimestamp);
+  }
+  if (queries.statistics[index] != VK_NULL_HANDLE) {
+    vkCmdResetQueryPool(commandBuffer, queries.statistics[index], 0, 1);
+    vkCmdBeginQuery(commandBuffer, queries.statistics[index], 0, 0);
+  }
+}
+
+void Profiler::endPass(VkCommandBuffer commandBuffer, Pass pass) {
+  if (frames.empty()) {
+    return;
+  }
+  const size_t index = static_cast<size_t>(pass);
+  FrameQueries& queries = frames[_mechanics.syncObjects.currentFrame];
+
+  if (queries.statistics[index] != VK_NULL_HANDLE) {
+    vkCmdEndQuery(commandBuffer, queries.statistics[index], 0);
+  }
+  if (queries.timestamps != VK_NULL_HANDLE) {
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                        queries.timestamps,
+                        static_cast<uint32_t>(index * 2 + 1));
+  }
+}
+
+// The pass of this frame was submitted, its queries are read back when the
+// frame comes round again
+void Profiler::markSubmitted(Pass pass) {
+  if (frames.empty()) {
+    return;
+  }
+  frames[_mechanics.syncObjects.currentFrame]
+      .written[static_cast<size_t>(pass)] = true;
+}
+
+void Profiler::addHostTime(Pass pass, double milliseconds) {
+  addSample(static_cast<size_t>(pass), milliseconds);
+}
+
+void Profiler::endFrame() {
+  if (++frameCount % framesPerReport == 0) {
+    logTimings();
+  }
+}
+
+Profiler::Timings Profiler::getTimings(Pass pass) const {
+  std::vector<double> sorted = samples[static_cast<size_t>(pass)];
+  if (sorted.empty()) {
+    return Timings{};
+  }
+  std::sort(sorted.begin(), sorted.end());
+  const size_t p99 = (sorted.size() * 99 + 99) / 100 - 1;
+  return Timings{
+      .min = sorted.front(),
+      .average = std::accumulate(sorted.begin(), sorted.end(), 0.0) /
+                 static_cast<double>(sorted.size()),
+      .p99 = sorted[p99]};
+}
+
+// Newest sample of the pass, 0 before the first one
+double Profiler::getLastMilliseconds(Pass pass) const {
+  const size_t index = static_cast<size_t>(pass);
+  if (samples[index].empty()) {
+    return 0.0;
+  }
+  return samples[index][(nextSample[index] + windowSize - 1) % windowSize];
+}
+
+// Queues of a family write timestampValidBits bits, the ones above are
+// undefined and the counter wraps around at the highest valid one
+uint64_t Profiler::getTimestampMask(uint32_t queueFamily) {
+  uint32_t familyCount;
+  vkGetPhysicalDeviceQueueFamilyProperties(_mechanics.mainDevice.physical,
+                                           &familyCount, nullptr);
+  std::vector<VkQueueFamilyProperties> families(familyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(_mechanics.mainDevice.physical,
+                                           &familyCount, families.data());
+
+  const uint32_t validBits = families[queueFamily].timestampValidBits;
+  return validBits >= 64 ? ~uint64_t{0} : (uint64_t{1} << validBits) - 1;
+}
+
+// Without the wait flag a result that is somehow not yet available is
+// dropped instead of stalling the frame
+void Profiler::readResults(FrameQueries& queries, size_t pass) {
+  queries.written[pass] = false;
+
+  if (queries.timestamps != VK_NULL_HANDLE) {
+    std::array<uint64_t, 2> ticks;
+    const VkResult result = vkGetQueryPoolResults(
+        _mechanics.mainDevice.logical, queries.timestamps,
+        static_cast<uint32_t>(pass * 2), 2, sizeof(ticks), ticks.data(),
+        sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    const uint64_t mask = timestampMasks[pass];
+    if (result == VK_SUCCESS && mask != 0) {
+      const uint64_t elapsed = ((ticks[1] & mask) - (ticks[0] & mask)) & mask;
+      addSample(pass,
+                static_cast<double>(elapsed) * timestampPeriod * 1.0e-6);
+    }
+  }
+
+  if (queries.statistics[pass] != VK_NULL_HANDLE) {
+    // Counts come in the bit order of the pass's statistics flags
+    std::array<uint64_t, 3> counts{};
+    const VkResult result = vkGetQueryPoolResults(
+        _mechanics.mainDevice.logical, queries.statistics[pass], 0, 1,
+        sizeof(counts), counts.data(), sizeof(counts), VK_QUERY_RESULT_64_BIT);
+    if (result != VK_SUCCESS) {
+      return;
+    }
+    if (static_cast<Pass>(pass) == Pass::compute) {
+      statistics[pass].computeShaderInvocations = counts[0];
+    } else {
+      statistics[pass].vertexShaderInvocations = counts[0];
+      statistics[pass].clippingPrimitives = counts[1];
+      statistics[pass].fragmentShaderInvocations = counts[2];
+    }
+  }
+}
+
+void Profiler::addSample(size_t pass, double milliseconds) {
+  std::vector<double>& passSamples = samples[pass];
+  if (passSamples.size() < windowSize) {
+    passSamples.push_back(milliseconds);
+  } else {
+    passSamples[nextSample[pass]] = milliseconds;
+  }
+  nextSample[pass] = (nextSample[pass] + 1) % windowSize;
+}
+
+void Profiler::logTimings() {
+  static const char* passNames[] = {"compute", "render ", "present"};
+
+  _log.console("{ PRO }", "last", samples[0].size(),
+               "frames, min / avg / p99 ms");
+  for (size_t pass = 0; pass < passCount; pass++) {
+    const Timings timings = getTimings(static_cast<Pass>(pass));
+    _log.console(_log.style.charLeader, passNames[pass], timings.min,
+                 timings.average, timings.p99);
+  }
+  const PipelineStatistics& compute = statistics[0];
+  const PipelineStatistics& render = statistics[1];
+  _log.console(_log.style.charLeader, "compute invocations",
+               compute.computeShaderInvocations);
+  _log.console(_log.style.charLeader, "vertex invocations",
+               render.vertexShaderInvocations, "primitives",
+               render.clippingPrimitives, "fragment invocations",
+               render.fragmentShaderInvocations);
+}
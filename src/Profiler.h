@@ -0,0 +1,86 @@
+#pragma once
+
+#include "vulkan/vulkan.h"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// GPU timings and pipeline statistics of the compute dispatch and the render
+// pass, plus the host time spent acquiring and presenting swap chain images.
+// Every frame in flight owns its query pools; their results are read when the
+// frame comes round again, after its submissions were waited on, so reading
+// never stalls and lags one frame behind.
+class Profiler {
+ public:
+  Profiler();
+  ~Profiler();
+
+  enum class Pass { compute, render, present };
+
+  struct Timings {
+    double min{0.0};
+    double average{0.0};
+    double p99{0.0};
+  };
+
+  // Last read counts of each pass, a pass only counts its own stages
+  struct PipelineStatistics {
+    uint64_t vertexShaderInvocations{0};
+    uint64_t clippingPrimitives{0};
+    uint64_t fragmentShaderInvocations{0};
+    uint64_t computeShaderInvocations{0};
+  };
+  std::array<PipelineStatistics, 2> statistics;
+
+ public:
+  void createQueryPools();
+  void destroyQueryPools();
+
+  void collectResults();
+  void beginPass(VkCommandBuffer commandBuffer, Pass pass);
+  void endPass(VkCommandBuffer commandBuffer, Pass pass);
+  void markSubmitted(Pass pass);
+  void addHostTime(Pass pass, double milliseconds);
+  void endFrame();
+
+  Timings getTimings(Pass pass) const;
+  double getLastMilliseconds(Pass pass) const;
+  static uint64_t getTimestampMask(uint32_t queueFamily);
+
+ private:
+  inline static const size_t passCount{3};
+  inline static const size_t gpuPassCount{2};
+  inline static const size_t windowSize{256};
+  inline static const uint64_t framesPerReport{1000};
+  // Compute may run on a queue without graphics, which must not query
+  // graphics statistics, so each pass has a pool of its own
+  inline static const std::array<VkQueryPipelineStatisticFlags, gpuPassCount>
+      pipelineStatistics{
+          VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT,
+          VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+              VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+              VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT};
+
+  struct FrameQueries {
+    VkQueryPool timestamps{VK_NULL_HANDLE};
+    std::array<VkQueryPool, gpuPassCount> statistics{};
+    std::array<bool, gpuPassCount> written{};
+  };
+  std::vector<FrameQueries> frames;
+
+  bool timestampsSupported;
+  bool statisticsSupported;
+  double timestampPeriod;
+  // Valid timestamp bits of the queue each pass is submitted to
+  std::array<uint64_t, gpuPassCount> timestampMasks;
+
+  // Rolling window of milliseconds per pass
+  std::array<std::vector<double>, passCount> samples;
+  std::array<size_t, passCount> nextSample;
+  uint64_t frameCount;
+
+  void readResults(FrameQueries& queries, size_t pass);
+  void addSample(size_t pass, double milliseconds);
+  void logTimings();
+};
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+
+// Counter-based random numbers, Squares by Widynski: a value depends only on
+// its counter and the key, so cells draw theirs independently of each other,
+// in any order, on any thread or on the device. initialize.comp computes the
+// same values.
+class Random {
+ public:
+  // What a cell draws a number for, the low bits of its counter
+  enum class Stream : uint64_t { alive, height, heightStep };
+
+  // Squares wants keys with well mixed bits, SplitMix64 of the seed
+  static constexpr uint64_t getKey(uint64_t seed) {
+    uint64_t z = seed + 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return (z ^ (z >> 31)) | 1ull;
+  }
+
+  static constexpr uint64_t getCounter(uint32_t index, Stream stream) {
+    return (static_cast<uint64_t>(index) << 2) | static_cast<uint64_t>(stream);
+  }
+
+  static constexpr uint32_t squares(uint64_t counter, uint64_t key) {
+    uint64_t x = counter * key;
+    const uint64_t y = x;
+    const uint64_t z = y + key;
+    x = x * x + y;
+    x = (x >> 32) | (x << 32);
+    x = x * x + z;
+    x = (x >> 32) | (x << 32);
+    x = x * x + y;
+    x = (x >> 32) | (x << 32);
+    return static_cast<uint32_t>((x * x + z) >> 32);
+  }
+};
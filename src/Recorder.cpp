@@ -0,0 +1,196 @@
+#include <cstring>
+#include <stdexcept>
+
+#include "CapitalEngine.h"
+#include "Recorder.h"
+
+static_assert(sizeof(Recorder::Header) == 24);
+static_assert(sizeof(Recorder::Frame) == 32);
+
+Recorder::Recorder()
+    : nextEntry{0},
+      frames{nullptr},
+      stopping{false},
+      writeFailed{false},
+      failureReported{false},
+      recordedFrames{0},
+      droppedFrames{0},
+      writtenBytes{0} {
+  _log.console("{ REC }", "constructing Recorder");
+}
+
+Recorder::~Recorder() {
+  stop();
+  _log.console("{ REC }", "destructing Recorder");
+}
+
+bool Recorder::isEnabled() const {
+  return !_control.recording.path.empty();
+}
+
+// One bit per cell, 32 cells per word with rows padded to whole words
+uint64_t Recorder::getFrameSize() const {
+  return sizeof(uint32_t) * ((_control.grid.dimensions[0] + 31) / 32) *
+         _control.grid.dimensions[1];
+}
+
+// mapped is the ring of recording.bufferCount frames the device copies into
+void Recorder::start(const void* mapped) {
+  const Control::Recording& recording = _control.recording;
+  _log.console("{ REC }", "recording every", recording.interval,
+               "generations to", recording.path);
+
+  file.open(recording.path, std::ios::binary | std::ios::trunc);
+  if (!file) {
+    throw std::runtime_error("\n!ERROR! failed to open recording: " +
+                             recording.path);
+  }
+  const Header header{
+      .magic = magic,
+      .version = version,
+      .width = static_cast<uint32_t>(_control.grid.dimensions[0]),
+      .height = static_cast<uint32_t>(_control.grid.dimensions[1]),
+      .interval = recording.interval};
+  file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+  if (!file) {
+    throw std::runtime_error("\n!ERROR! failed to write recording: " +
+                             recording.path);
+  }
+
+  entries.assign(recording.bufferCount, Entry{});
+  frames = static_cast<const uint8_t*>(mapped);
+  stopping = false;
+  writeFailed = false;
+  failureReported = false;
+  writer = std::thread(&Recorder::writeFrames, this);
+}
+
+// The entry the generation's changes are copied into, none when the
+// generation is not due or every entry is still in use
+std::optional<uint32_t> Recorder::acquire(uint64_t generation,
+                                          uint64_t passedHours) {
+  if (generation % _control.recording.interval != 0) {
+    return std::nullopt;
+  }
+  const uint32_t entry = nextEntry;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (entries[entry].state != State::free) {
+      droppedFrames++;
+      return std::nullopt;
+    }
+    entries[entry] = {.state = State::pending,
+                      .generation = generation,
+                      .passedHours = passedHours,
+                      .timelineValue = _mechanics.getTimelineValue(generation)};
+  }
+  pending.push_back(entry);
+  nextEntry = (entry + 1) % static_cast<uint32_t>(entries.size());
+  return entry;
+}
+
+// Queues the entries whose generation the device has finished, never waits
+void Recorder::collect() {
+  checkWritten();
+  if (pending.empty()) {
+    return;
+  }
+  uint64_t value;
+  _mechanics.result(vkGetSemaphoreCounterValue, _mechanics.mainDevice.logical,
+                    _mechanics.syncObjects.simulationTimeline, &value);
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    while (!pending.empty() &&
+           entries[pending.front()].timelineValue <= value) {
+      entries[pending.front()].state = State::queued;
+      queued.push_back(pending.front());
+      pending.pop_front();
+    }
+  }
+  condition.notify_one();
+}
+
+// Writes what the device has finished and ends the recording. Entries the
+// device did not finish are dropped.
+void Recorder::stop() {
+  if (!writer.joinable()) {
+    return;
+  }
+  collect();
+  droppedFrames += pending.size();
+  pending.clear();
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  condition.notify_one();
+  writer.join();
+  file.close();
+  writeFailed = writeFailed || !file;
+
+  _log.console("{ REC }", "recorded", recordedFrames, "frames,", droppedFrames,
+               "dropped");
+  _log.console(_log.style.charLeader, writtenBytes, "bytes written to",
+               _control.recording.path);
+  checkWritten();
+}
+
+void Recorder::writeFrames() {
+  const uint64_t frameSize = getFrameSize();
+  std::vector<uint32_t> words(frameSize / sizeof(uint32_t));
+  std::vector<uint32_t> encoded(words.size());
+
+  while (true) {
+    uint32_t entry;
+    Frame frame{};
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      condition.wait(lock, [this] { return stopping || !queued.empty(); });
+      if (queued.empty()) {
+        return;
+      }
+      entry = queued.front();
+      queued.pop_front();
+      frame.generation = entries[entry].generation;
+      frame.passedHours = entries[entry].passedHours;
+    }
+
+    // One sequential read of the mapped entry, then it can be reused
+    std::memcpy(words.data(), frames + frameSize * entry, frameSize);
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      entries[entry].state = State::free;
+    }
+
+    const size_t size =
+        Checkpoint::encodeRunLength(words, encoded.data(), encoded.size());
+    const uint32_t* data = size > 0 ? encoded.data() : words.data();
+    frame.encoding = static_cast<uint32_t>(size > 0
+                                               ? Checkpoint::Encoding::runLength
+                                               : Checkpoint::Encoding::raw);
+    frame.size = sizeof(uint32_t) * (size > 0 ? size : words.size());
+    file.write(reinterpret_cast<const char*>(&frame), sizeof(Frame));
+    file.write(reinterpret_cast<const char*>(data),
+               static_cast<std::streamsize>(frame.size));
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!file) {
+      // A full disk or an I/O error, the frames after this one are dropped
+      writeFailed = true;
+      return;
+    }
+    recordedFrames++;
+    writtenBytes += sizeof(Frame) + frame.size;
+  }
+}
+
+// Throws once after a write failed, so a truncated recording does not pass
+// for a complete one
+void Recorder::checkWritten() {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (writeFailed && !failureReported) {
+    failureReported = true;
+    throw std::runtime_error("\n!ERROR! failed to write recording: " +
+                             _control.recording.path);
+  }
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+// Streams the changes of every recording.interval-th generation to a file for
+// offline analysis. delta.comp turns a generation into one bit per cell that
+// changed since the last recorded generation and the command buffer copies
+// that frame into an entry of a host visible ring. Once the simulation
+// timeline passed the generation, the entry is queued for a writer thread,
+// which run length encodes the frame and frees the entry again. When no entry
+// is free the generation is dropped instead of waiting, its changes fold into
+// the next recorded frame, so a slow disk coarsens the recording but never
+// stalls a frame. The first frame holds the alive cells themselves.
+//
+// A file is a Header followed by frames, a Frame and size bytes of words,
+// raw or run length encoded as in Checkpoint.
+class Recorder {
+ public:
+  Recorder();
+  ~Recorder();
+
+  inline static const std::array<char, 8> magic{'C', 'A', 'P', 'D',
+                                                'E', 'L', 'T', 'A'};
+  inline static const uint32_t version{1};
+
+  struct Header {
+    std::array<char, 8> magic;
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t interval;
+  };
+
+  struct Frame {
+    uint64_t generation;
+    uint64_t passedHours;
+    uint64_t size;
+    uint32_t encoding;
+    uint32_t reserved;
+  };
+
+ public:
+  bool isEnabled() const;
+  uint64_t getFrameSize() const;
+  void start(const void* mapped);
+  std::optional<uint32_t> acquire(uint64_t generation, uint64_t passedHours);
+  void collect();
+  void stop();
+
+ private:
+  enum class State { free, pending, queued };
+
+  struct Entry {
+    State state{State::free};
+    uint64_t generation{0};
+    uint64_t passedHours{0};
+    uint64_t timelineValue{0};
+  };
+  std::vector<Entry> entries;
+  uint32_t nextEntry;
+  const uint8_t* frames;
+
+  // Entries the device still writes, in the order they were acquired. Only
+  // the main thread touches them.
+  std::deque<uint32_t> pending;
+
+  // Entries handed to the writer, their states and the counters below are
+  // guarded by mutex
+  std::deque<uint32_t> queued;
+  std::mutex mutex;
+  std::condition_variable condition;
+  std::thread writer;
+  bool stopping;
+  // Set by the writer when the file stops taking frames, reported once by
+  // the main thread
+  bool writeFailed;
+  bool failureReported;
+
+  std::ofstream file;
+  uint64_t recordedFrames;
+  uint64_t droppedFrames;
+  uint64_t writtenBytes;
+
+  void writeFrames();
+  void checkWritten();
+};
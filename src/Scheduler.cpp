@@ -0,0 +1,121 @@
+#include <algorithm>
+#include <cmath>
+
+#include "CapitalEngine.h"
+#include "Scheduler.h"
+
+Scheduler::Scheduler()
+    : statistics{},
+      lastFrame{},
+      accumulator{0.0},
+      millisecondsPerGeneration{0.0},
+      generationLimit{1},
+      latestSlot{0},
+      scheduled{} {
+  _log.console("{ SCH }", "constructing Scheduler");
+}
+
+Scheduler::~Scheduler() {
+  _log.console("{ SCH }", "destructing Scheduler");
+}
+
+// Generations the frame about to be recorded computes. A speed of 0 is
+// unlimited and takes as many as the governor allows, paused takes none.
+uint32_t Scheduler::scheduleFrame() {
+  const auto now = std::chrono::steady_clock::now();
+  const double frameMilliseconds =
+      statistics.frames == 0
+          ? 0.0
+          : std::chrono::duration<double, std::milli>(now - lastFrame).count();
+  lastFrame = now;
+  govern(frameMilliseconds);
+
+  uint32_t generations = generationLimit;
+  if (_control.timer.paused) {
+    generations = 0;
+    accumulator = 0.0;
+  } else if (_control.timer.speed > 0.0f) {
+    accumulator += frameMilliseconds * 1.0e-3 * _control.timer.speed;
+    generations =
+        std::min(static_cast<uint32_t>(accumulator), generationLimit);
+    accumulator -= generations;
+
+    // Catching up on more than a frame's worth would only stretch the next
+    // frames and fall further behind, the rest of the backlog is dropped
+    const double backlog = std::floor(accumulator) - generationLimit;
+    if (backlog > 0.0) {
+      statistics.droppedGenerations += static_cast<uint64_t>(backlog);
+      accumulator -= backlog;
+    }
+  }
+
+  scheduled[statistics.frames % historyLength] = generations;
+  statistics.generations += generations;
+  if (++statistics.frames % framesPerReport == 0) {
+    logSchedule();
+  }
+  return generations;
+}
+
+// Ring slot the next generation is written to, from then on the latest
+uint32_t Scheduler::advanceSlot() {
+  latestSlot = (latestSlot + 1) % _control.timer.ringSize;
+  return latestSlot;
+}
+
+uint32_t Scheduler::getLatestSlot() const {
+  return latestSlot;
+}
+
+uint32_t Scheduler::getGenerationLimit() const {
+  return generationLimit;
+}
+
+// Estimates the milliseconds a generation takes from the GPU time of the
+// compute pass and allows as many per frame as fit into the frame budget.
+// Without timestamps the whole frame is charged to the generations, which
+// errs on the side of the frame rate. A frame never computes more than
+// ringSize - 1 generations, the next would overwrite the one the previous
+// frame may still be drawing.
+void Scheduler::govern(double frameMilliseconds) {
+  const double computeMilliseconds =
+      _profiler.getLastMilliseconds(Profiler::Pass::compute);
+  const uint32_t timedGenerations =
+      scheduled[(statistics.frames + 1) % historyLength];
+  const uint32_t lastGenerations =
+      statistics.frames == 0
+          ? 0
+          : scheduled[(statistics.frames - 1) % historyLength];
+
+  double sample = 0.0;
+  if (computeMilliseconds > 0.0) {
+    if (timedGenerations > 0) {
+      sample = computeMilliseconds / timedGenerations;
+    }
+  } else if (statistics.frames > historyLength && lastGenerations > 0) {
+    sample = frameMilliseconds / lastGenerations;
+  }
+  if (sample > 0.0) {
+    millisecondsPerGeneration =
+        millisecondsPerGeneration > 0.0
+            ? millisecondsPerGeneration +
+                  smoothing * (sample - millisecondsPerGeneration)
+            : sample;
+  }
+
+  const double ringLimit = static_cast<double>(_control.timer.ringSize - 1);
+  if (millisecondsPerGeneration > 0.0) {
+    generationLimit = static_cast<uint32_t>(
+        std::clamp(_control.timer.frameBudget / millisecondsPerGeneration,
+                   1.0, ringLimit));
+  }
+}
+
+void Scheduler::logSchedule() {
+  _log.console("{ SCH }", statistics.generations, "generations in",
+               statistics.frames, "frames, up to", generationLimit,
+               "per frame");
+  _log.console(_log.style.charLeader, millisecondsPerGeneration,
+               "ms per generation,", statistics.droppedGenerations,
+               "dropped behind schedule");
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+#include "Mechanics.h"
+
+// Decides how many generations each frame computes, independent of the frame
+// rate. Wall time fills an accumulator at timer.speed generations per second
+// and whole generations are taken out of it, at most as many as the governor
+// expects to fit into the frame budget and the ring can hold. Generations are
+// written round a ring of timer.ringSize cell buffers; the renderer draws the
+// latest completed one.
+class Scheduler {
+ public:
+  Scheduler();
+  ~Scheduler();
+
+  struct Statistics {
+    uint64_t frames{0};
+    uint64_t generations{0};
+    uint64_t droppedGenerations{0};
+  } statistics;
+
+  uint32_t scheduleFrame();
+  uint32_t advanceSlot();
+  uint32_t getLatestSlot() const;
+  uint32_t getGenerationLimit() const;
+
+ private:
+  inline static const uint64_t framesPerReport{1000};
+  inline static const double smoothing{0.1};
+  // The profiler reads the compute queries of a frame when its slot comes
+  // round again, just before it is scheduled, so its latest timing belongs to
+  // the frame MAX_FRAMES_IN_FLIGHT back
+  inline static const size_t historyLength{MAX_FRAMES_IN_FLIGHT + 1};
+
+  std::chrono::steady_clock::time_point lastFrame;
+  double accumulator;
+  double millisecondsPerGeneration;
+  uint32_t generationLimit;
+  uint32_t latestSlot;
+  std::array<uint32_t, historyLength> scheduled;
+
+  void govern(double frameMilliseconds);
+  void logSchedule();
+};
@@ -0,0 +1,80 @@
+#include "CapitalEngine.h"
+#include "Statistics.h"
+
+static_assert(sizeof(Statistics::Block) == 16 * sizeof(uint32_t));
+
+Statistics::Statistics() {
+  _log.console("{ STA }", "constructing Statistics");
+}
+
+Statistics::~Statistics() {
+  _log.console("{ STA }", "destructing Statistics");
+}
+
+bool Statistics::isEnabled() const {
+  return _control.statistics.enabled;
+}
+
+// Once the last submission of this frame has been waited on, reads back the
+// blocks it copied
+void Statistics::collectResults() {
+  if (!isEnabled() || submissions.empty()) {
+    return;
+  }
+  const uint32_t frame = _mechanics.syncObjects.currentFrame;
+  Submission& submission = submissions[frame];
+  const Block* blocks =
+      static_cast<const Block*>(_memory.buffers.statisticsMapped[frame]);
+
+  for (uint32_t i = 0; i < submission.generations; i++) {
+    const Block& block = blocks[i];
+    const Sample sample{.generation = submission.firstGeneration + i,
+                        .population = block.population,
+                        .births = block.births,
+                        .deaths = block.deaths,
+                        .neighbours = block.neighbours};
+    if (series.size() == seriesLength) {
+      series.pop_front();
+    }
+    series.push_back(sample);
+    if (sample.generation % generationsPerReport == 0) {
+      logSample(sample);
+    }
+  }
+  submission.generations = 0;
+}
+
+void Statistics::markSubmitted(uint64_t firstGeneration,
+                               uint32_t generations) {
+  if (!isEnabled()) {
+    return;
+  }
+  if (submissions.empty()) {
+    submissions.resize(MAX_FRAMES_IN_FLIGHT);
+  }
+  submissions[_mechanics.syncObjects.currentFrame] = {
+      .firstGeneration = firstGeneration, .generations = generations};
+}
+
+const std::deque<Statistics::Sample>& Statistics::getSeries() const {
+  return series;
+}
+
+std::optional<Statistics::Sample> Statistics::getLatest() const {
+  if (series.empty()) {
+    return std::nullopt;
+  }
+  return series.back();
+}
+
+void Statistics::logSample(const Sample& sample) const {
+  _log.console("{ STA }", "generation", sample.generation, "population",
+               sample.population, "births", sample.births, "deaths",
+               sample.deaths);
+  _log.console(_log.style.charLeader, "alive by neighbours",
+               sample.neighbours[0], sample.neighbours[1],
+               sample.neighbours[2], sample.neighbours[3],
+               sample.neighbours[4], sample.neighbours[5],
+               sample.neighbours[6], sample.neighbours[7],
+               sample.neighbours[8]);
+}
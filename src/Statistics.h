@@ -0,0 +1,63 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <vector>
+
+// Population time series of the cells backend. shader.comp reduces each
+// generation it steps into a Block, one per generation of the submission,
+// and the submission copies the blocks into its frame's host visible buffer.
+// Like the profiler's queries they are read when the frame comes round
+// again, after its submissions were waited on, so reading never stalls.
+class Statistics {
+ public:
+  Statistics();
+  ~Statistics();
+
+  inline static const uint32_t histogramSize{9};
+
+  // Layout shader.comp adds into, 16 words
+  struct Block {
+    uint32_t population;
+    uint32_t births;
+    uint32_t deaths;
+    uint32_t reserved;
+    // Alive cells by the alive neighbours they were stepped with, Larger
+    // than Life counts above 8 share the last bin
+    std::array<uint32_t, histogramSize> neighbours;
+    std::array<uint32_t, 3> padding;
+  };
+
+  struct Sample {
+    uint64_t generation{0};
+    uint32_t population{0};
+    uint32_t births{0};
+    uint32_t deaths{0};
+    std::array<uint32_t, histogramSize> neighbours{};
+  };
+
+ public:
+  bool isEnabled() const;
+  void collectResults();
+  void markSubmitted(uint64_t firstGeneration, uint32_t generations);
+
+  // Oldest first, at most seriesLength samples
+  const std::deque<Sample>& getSeries() const;
+  std::optional<Sample> getLatest() const;
+
+ private:
+  inline static const size_t seriesLength{4096};
+  inline static const uint64_t generationsPerReport{1000};
+
+  // Generations of each frame's last submission whose blocks were not read
+  struct Submission {
+    uint64_t firstGeneration{0};
+    uint32_t generations{0};
+  };
+  std::vector<Submission> submissions;
+  std::deque<Sample> series;
+
+  void logSample(const Sample& sample) const;
+};
@@ -0,0 +1,91 @@
+#include <algorithm>
+
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(uint32_t threadCount)
+    : ranges(std::max(threadCount, 1u)),
+      currentTask{nullptr},
+      batch{0},
+      runningWorkers{0},
+      stopping{false} {
+  for (uint32_t worker = 1; worker < ranges.size(); worker++) {
+    workers.emplace_back(&ThreadPool::workerLoop, this, worker);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  startCondition.notify_all();
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+}
+
+void ThreadPool::parallelFor(uint32_t taskCount,
+                             const std::function<void(uint32_t)>& task) {
+  const uint32_t workerCount = static_cast<uint32_t>(ranges.size());
+  for (uint32_t worker = 0; worker < workerCount; worker++) {
+    const uint64_t begin = uint64_t{taskCount} * worker / workerCount;
+    ranges[worker].end =
+        static_cast<uint32_t>(uint64_t{taskCount} * (worker + 1) / workerCount);
+    ranges[worker].next.store(static_cast<uint32_t>(begin),
+                              std::memory_order_relaxed);
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    currentTask = &task;
+    runningWorkers = workerCount - 1;
+    batch++;
+  }
+  startCondition.notify_all();
+
+  runTasks(0);
+
+  std::unique_lock<std::mutex> lock(mutex);
+  finishCondition.wait(lock, [this] { return runningWorkers == 0; });
+  currentTask = nullptr;
+}
+
+uint32_t ThreadPool::getThreadCount() const {
+  return static_cast<uint32_t>(ranges.size());
+}
+
+void ThreadPool::workerLoop(uint32_t worker) {
+  uint64_t finishedBatch = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      startCondition.wait(
+          lock, [&] { return stopping || batch != finishedBatch; });
+      if (stopping) {
+        return;
+      }
+      finishedBatch = batch;
+    }
+
+    runTasks(worker);
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      runningWorkers--;
+    }
+    finishCondition.notify_one();
+  }
+}
+
+// Own range first, then the other workers' ranges starting with the next one
+void ThreadPool::runTasks(uint32_t worker) {
+  const uint32_t workerCount = static_cast<uint32_t>(ranges.size());
+  for (uint32_t offset = 0; offset < workerCount; offset++) {
+    Range& range = ranges[(worker + offset) % workerCount];
+    uint32_t task;
+    while ((task = range.next.fetch_add(1, std::memory_order_relaxed)) <
+           range.end) {
+      (*currentTask)(task);
+    }
+  }
+}
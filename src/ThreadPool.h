@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent workers for data parallel loops. parallelFor splits the tasks
+// into one contiguous range per worker, a worker that runs out steals from
+// the others so uneven tasks still finish together. The calling thread
+// works as worker 0.
+class ThreadPool {
+ public:
+  explicit ThreadPool(uint32_t threadCount);
+  ~ThreadPool();
+
+  void parallelFor(uint32_t taskCount,
+                   const std::function<void(uint32_t)>& task);
+  uint32_t getThreadCount() const;
+
+ private:
+  struct alignas(64) Range {
+    std::atomic<uint32_t> next{0};
+    uint32_t end{0};
+  };
+
+  std::vector<std::thread> workers;
+  std::vector<Range> ranges;
+  const std::function<void(uint32_t)>* currentTask;
+
+  std::mutex mutex;
+  std::condition_variable startCondition;
+  std::condition_variable finishCondition;
+  uint64_t batch;
+  uint32_t runningWorkers;
+  bool stopping;
+
+  void workerLoop(uint32_t worker);
+  void runTasks(uint32_t worker);
+};
@@ -0,0 +1,303 @@
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include "CapitalEngine.h"
+#include "Uploader.h"
+
+Uploader::Uploader()
+    : timeline{VK_NULL_HANDLE},
+      commandPool{VK_NULL_HANDLE},
+      ring{VK_NULL_HANDLE},
+      current{0},
+      recording{false},
+      batchBytes{0},
+      head{0},
+      tail{0},
+      submittedValue{0},
+      completedValue{0},
+      foreignValue{0} {
+  _log.console("{ UPL }", "constructing Uploader");
+}
+
+Uploader::~Uploader() {
+  _log.console("{ UPL }", "destructing Uploader");
+}
+
+void Uploader::create() {
+  _log.console("{ UPL }", "creating Uploader");
+
+  VkCommandPoolCreateInfo poolInfo{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+      .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT |
+               VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+      .queueFamilyIndex =
+          _mechanics.queues.familyIndices.transferFamily.value()};
+  _mechanics.result(vkCreateCommandPool, _mechanics.mainDevice.logical,
+                    &poolInfo, nullptr, &commandPool);
+
+  std::vector<VkCommandBuffer> commandBuffers(batchCount);
+  VkCommandBufferAllocateInfo allocateInfo{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+      .commandPool = commandPool,
+      .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+      .commandBufferCount = batchCount};
+  _mechanics.result(vkAllocateCommandBuffers, _mechanics.mainDevice.logical,
+                    &allocateInfo, commandBuffers.data());
+  batches.resize(batchCount);
+  for (uint32_t i = 0; i < batchCount; i++) {
+    batches[i] = Batch{.commandBuffer = commandBuffers[i], .value = 0,
+                       .end = 0};
+  }
+
+  VkSemaphoreTypeCreateInfo timelineTypeInfo{
+      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+      .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+      .initialValue = 0};
+  VkSemaphoreCreateInfo timelineInfo{
+      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+      .pNext = &timelineTypeInfo};
+  _mechanics.result(vkCreateSemaphore, _mechanics.mainDevice.logical,
+                    &timelineInfo, nullptr, &timeline);
+
+  _memory.createBuffer(ringSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                           VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                       ring, ringMemory);
+}
+
+// Waits for every batch, call before the device is destroyed
+void Uploader::destroy() {
+  if (commandPool == VK_NULL_HANDLE) {
+    return;
+  }
+  wait(flush());
+  vkDestroyBuffer(_mechanics.mainDevice.logical, ring, nullptr);
+  _allocator.free(ringMemory);
+  vkDestroySemaphore(_mechanics.mainDevice.logical, timeline, nullptr);
+  vkDestroyCommandPool(_mechanics.mainDevice.logical, commandPool, nullptr);
+  commandPool = VK_NULL_HANDLE;
+}
+
+// Ring space for size bytes. Copy it with copyStaged before staging again,
+// the next stage may submit the batch.
+Uploader::Staging Uploader::stage(VkDeviceSize size) {
+  if (size > ringSize) {
+    throw std::runtime_error("\n!ERROR! staging " + std::to_string(size) +
+                             " bytes, the upload ring holds " +
+                             std::to_string(ringSize) + "!");
+  }
+  if (recording && batchBytes > 0 && batchBytes + size > batchSize) {
+    flush();
+  }
+  const uint64_t position = reserve(size);
+  if (!recording) {
+    begin();
+  }
+  batchBytes += size;
+
+  const VkDeviceSize offset = position % ringSize;
+  return Staging{.data = static_cast<char*>(ringMemory.mapped) + offset,
+                 .offset = offset,
+                 .size = size};
+}
+
+void Uploader::copyStaged(const Staging& staging,
+                          VkBuffer destination,
+                          VkDeviceSize offset) {
+  const VkBufferCopy copyRegion{
+      .srcOffset = staging.offset, .dstOffset = offset, .size = staging.size};
+  vkCmdCopyBuffer(batches[current].commandBuffer, ring, destination, 1,
+                  &copyRegion);
+}
+
+// Stages source once, a batch at a time, and copies it to the start of every
+// destination
+void Uploader::upload(const void* source,
+                      VkDeviceSize size,
+                      const std::vector<VkBuffer>& destinations) {
+  for (VkDeviceSize offset = 0; offset < size; offset += batchSize) {
+    const Staging staging = stage(std::min(batchSize, size - offset));
+    std::memcpy(staging.data, static_cast<const char*>(source) + offset,
+                static_cast<size_t>(staging.size));
+    for (VkBuffer destination : destinations) {
+      copyStaged(staging, destination, offset);
+    }
+  }
+}
+
+// Device to device or readback copy in the current batch, the host may read
+// a readback once flush's value is reached
+void Uploader::copy(VkBuffer source,
+                    VkBuffer destination,
+                    VkDeviceSize size) {
+  if (!recording) {
+    begin();
+  }
+  const VkBufferCopy copyRegion{.size = size};
+  vkCmdCopyBuffer(batches[current].commandBuffer, source, destination, 1,
+                  &copyRegion);
+}
+
+// Sets every word of destination without staging anything
+void Uploader::fill(VkBuffer destination, uint32_t data) {
+  if (!recording) {
+    begin();
+  }
+  vkCmdFillBuffer(batches[current].commandBuffer, destination, 0,
+                  VK_WHOLE_SIZE, data);
+}
+
+// Later submissions wait for the other timeline to reach value, as uploads
+// overwriting what earlier submissions on other queues still read
+void Uploader::waitFor(VkSemaphore semaphore, uint64_t value) {
+  for (size_t i = 0; i < dependencies.size(); i++) {
+    if (dependencies[i] == semaphore) {
+      dependencyValues[i] = std::max(dependencyValues[i], value);
+      return;
+    }
+  }
+  dependencies.push_back(semaphore);
+  dependencyValues.push_back(value);
+}
+
+// Submits a one-time command buffer of another queue after every upload so
+// far, as the next value of the timeline. The caller frees it once
+// isReached returns true for the returned value.
+uint64_t Uploader::submit(VkQueue queue, VkCommandBuffer commandBuffer) {
+  flush();
+  foreignValue = ++submittedValue;
+  submitWaiting(queue, commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                foreignValue - 1);
+  return foreignValue;
+}
+
+// Submits the batch being recorded. The timeline reaches the returned value
+// once every upload and copy so far is done.
+uint64_t Uploader::flush() {
+  if (!recording) {
+    return submittedValue;
+  }
+  Batch& batch = batches[current];
+
+  // Readbacks are read by the host once the value is reached
+  const VkMemoryBarrier barrier{.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                                .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+                                .dstAccessMask = VK_ACCESS_HOST_READ_BIT};
+  vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, nullptr,
+                       0, nullptr);
+  _mechanics.result(vkEndCommandBuffer, batch.commandBuffer);
+
+  batch.value = ++submittedValue;
+  batch.end = head;
+  submitWaiting(_mechanics.queues.transfer, batch.commandBuffer,
+                VK_PIPELINE_STAGE_TRANSFER_BIT, foreignValue);
+
+  recording = false;
+  current = (current + 1) % batchCount;
+  return submittedValue;
+}
+
+// Signals submittedValue once the dependencies and the timeline value are
+// reached, 0 is always reached
+void Uploader::submitWaiting(VkQueue queue,
+                             VkCommandBuffer commandBuffer,
+                             VkPipelineStageFlags waitStage,
+                             uint64_t value) {
+  std::vector<VkSemaphore> waitSemaphores = dependencies;
+  std::vector<uint64_t> waitValues = dependencyValues;
+  waitSemaphores.push_back(timeline);
+  waitValues.push_back(value);
+  const std::vector<VkPipelineStageFlags> waitStages(waitSemaphores.size(),
+                                                     waitStage);
+
+  VkTimelineSemaphoreSubmitInfo timelineInfo{
+      .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+      .waitSemaphoreValueCount = static_cast<uint32_t>(waitValues.size()),
+      .pWaitSemaphoreValues = waitValues.data(),
+      .signalSemaphoreValueCount = 1,
+      .pSignalSemaphoreValues = &submittedValue};
+  VkSubmitInfo submitInfo{
+      .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+      .pNext = &timelineInfo,
+      .waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size()),
+      .pWaitSemaphores = waitSemaphores.data(),
+      .pWaitDstStageMask = waitStages.data(),
+      .commandBufferCount = 1,
+      .pCommandBuffers = &commandBuffer,
+      .signalSemaphoreCount = 1,
+      .pSignalSemaphores = &timeline};
+  _mechanics.result(vkQueueSubmit, queue, 1, &submitInfo, VK_NULL_HANDLE);
+}
+
+// Blocks until the timeline reaches value, a value returned by flush
+void Uploader::wait(uint64_t value) {
+  if (value <= completedValue) {
+    return;
+  }
+  VkSemaphoreWaitInfo waitInfo{.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+                               .semaphoreCount = 1,
+                               .pSemaphores = &timeline,
+                               .pValues = &value};
+  _mechanics.result(vkWaitSemaphores, _mechanics.mainDevice.logical,
+                    &waitInfo, UINT64_MAX);
+  completedValue = value;
+}
+
+bool Uploader::isReached(uint64_t value) {
+  retire();
+  return value <= completedValue;
+}
+
+// The batch's command buffer is reused once its last submission is done
+void Uploader::begin() {
+  Batch& batch = batches[current];
+  wait(batch.value);
+  _mechanics.result(vkResetCommandBuffer, batch.commandBuffer, 0);
+
+  VkCommandBufferBeginInfo beginInfo{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+      .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT};
+  _mechanics.result(vkBeginCommandBuffer, batch.commandBuffer, &beginInfo);
+  recording = true;
+  batchBytes = 0;
+}
+
+// Ring position of size contiguous bytes. While the ring is full the batch
+// being recorded is submitted and the oldest pending one waited for.
+uint64_t Uploader::reserve(VkDeviceSize size) {
+  retire();
+  while (true) {
+    uint64_t position = (head + alignment - 1) / alignment * alignment;
+    if (position % ringSize + size > ringSize) {
+      position += ringSize - position % ringSize;
+    }
+    if (position + size - tail <= ringSize) {
+      head = position + size;
+      return position;
+    }
+    if (recording) {
+      flush();
+    } else {
+      wait(completedValue + 1);
+    }
+    retire();
+  }
+}
+
+// Frees the ring space of completed batches, all of it once none is pending
+void Uploader::retire() {
+  _mechanics.result(vkGetSemaphoreCounterValue, _mechanics.mainDevice.logical,
+                    timeline, &completedValue);
+  for (const Batch& batch : batches) {
+    if (batch.value != 0 && batch.value <= completedValue) {
+      tail = std::max(tail, batch.end);
+    }
+  }
+  if (completedValue == submittedValue && !recording) {
+    head = (head + ringSize - 1) / ringSize * ringSize;
+    tail = head;
+  }
+}
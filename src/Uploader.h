@@ -0,0 +1,96 @@
+#pragma once
+
+#include "vulkan/vulkan.h"
+
+#include <cstdint>
+#include <vector>
+
+#include "Allocator.h"
+
+// Uploads and readbacks, batched into a few submissions on the transfer
+// queue, see Queues::FamilyIndices::transferFamily. Data is staged in a
+// persistently mapped ring and copied from there. Every submission signals
+// the next value of the timeline; the ring space and command buffer of a
+// batch are reused once it is reached, so nothing waits for a queue to go
+// idle. Submissions reading what was uploaded wait for flush() on the
+// device instead. One-time commands of other queues take values of the
+// timeline too, see submit, so the same wait covers them.
+class Uploader {
+ public:
+  Uploader();
+  ~Uploader();
+
+  // Ring space handed out by stage, the host writes size bytes to data
+  struct Staging {
+    void* data;
+    VkDeviceSize offset;
+    VkDeviceSize size;
+  };
+
+  // A batch is submitted once this much is staged, so the host fills the
+  // next batch while the transfer queue copies the ones before
+  inline static const VkDeviceSize batchSize{16ull << 20};
+
+  VkSemaphore timeline;
+
+ public:
+  void create();
+  void destroy();
+
+  Staging stage(VkDeviceSize size);
+  void copyStaged(const Staging& staging,
+                  VkBuffer destination,
+                  VkDeviceSize offset);
+  void upload(const void* source,
+              VkDeviceSize size,
+              const std::vector<VkBuffer>& destinations);
+  void copy(VkBuffer source, VkBuffer destination, VkDeviceSize size);
+  void fill(VkBuffer destination, uint32_t data);
+  void waitFor(VkSemaphore semaphore, uint64_t value);
+  uint64_t submit(VkQueue queue, VkCommandBuffer commandBuffer);
+  uint64_t flush();
+  void wait(uint64_t value);
+  bool isReached(uint64_t value);
+
+ private:
+  inline static const VkDeviceSize ringSize{4 * batchSize};
+  inline static const uint32_t batchCount{8};
+  // Of every staged range, enough for any element type uploaded
+  inline static const VkDeviceSize alignment{16};
+
+  struct Batch {
+    VkCommandBuffer commandBuffer;
+    // Signalled by its last submission, 0 before the first
+    uint64_t value;
+    // Ring position after its last staged byte
+    uint64_t end;
+  };
+
+  VkCommandPool commandPool;
+  VkBuffer ring;
+  Allocator::Allocation ringMemory;
+  std::vector<Batch> batches;
+  uint32_t current;
+  bool recording;
+  VkDeviceSize batchBytes;
+  // Ring positions count every byte ever staged: up to head is handed out,
+  // from tail on still read by pending batches
+  uint64_t head;
+  uint64_t tail;
+  uint64_t submittedValue;
+  uint64_t completedValue;
+  // Last value signalled by another queue, batches wait for it to keep the
+  // timeline increasing
+  uint64_t foreignValue;
+  // Of other timelines, every later submission waits for them on the device
+  std::vector<VkSemaphore> dependencies;
+  std::vector<uint64_t> dependencyValues;
+
+  void begin();
+  uint64_t reserve(VkDeviceSize size);
+  void retire();
+  void submitWaiting(VkQueue queue,
+                     VkCommandBuffer commandBuffer,
+                     VkPipelineStageFlags waitStage,
+                     uint64_t value);
+};
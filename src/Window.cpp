@@ -8,13 +8,14 @@
 
 Window::Window() : window{nullptr}, framebufferResized{false}, mouse{} {
   _log.console("{ [-] }", "constructing Window");
-  initWindow();
 }
 
 Window::~Window() {
   _log.console("{ [-] }", "destructing Window");
-  glfwDestroyWindow(window);
-  glfwTerminate();
+  if (window != nullptr) {
+    glfwDestroyWindow(window);
+    glfwTerminate();
+  }
 }
 
 void Window::initWindow() {
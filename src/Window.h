@@ -24,9 +24,9 @@ class Window {
     std::array<Button, 3> previousButtonDown;
   } mouse;
 
+  void initWindow();
   void setMouse();
 
  private:
-  void initWindow();
   static void windowResize(GLFWwindow* win, int width, int height);
 };
@@ -3,12 +3,12 @@
 
 #include "CapitalEngine.h"
 #include "Library.h"
+#include "Random.h"
 #include "World.h"
 
 #include <algorithm>
 #include <cstdlib>
 #include <ctime>
-#include <random>
 
 World::World() {
   _log.console("{ (X) }", "constructing World");
@@ -20,80 +20,47 @@ World::~World() {
 
 std::vector<VkVertexInputBindingDescription> World::getBindingDescriptions() {
   std::vector<VkVertexInputBindingDescription> bindingDescriptions{
-      {0, sizeof(Cell), VK_VERTEX_INPUT_RATE_INSTANCE}};
+      {0, sizeof(Cell), VK_VERTEX_INPUT_RATE_INSTANCE},
+      {1, sizeof(Landscape), VK_VERTEX_INPUT_RATE_INSTANCE}};
   return bindingDescriptions;
 }
 
 std::vector<VkVertexInputAttributeDescription>
 World::getAttributeDescriptions() {
   std::vector<VkVertexInputAttributeDescription> attributeDescriptions{
-      {0, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(Cell, position)},
-      {1, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(Cell, color)},
-      {2, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(Cell, size)},
-      {3, 0, VK_FORMAT_R32G32B32A32_SINT, offsetof(Cell, states)},
-      {4, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(Cell, tileSidesHeight)},
-      {5, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(Cell, tileCornersHeight)}};
+      {0, 1, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(Landscape, position)},
+      {1, 0, VK_FORMAT_R32_UINT, offsetof(Cell, state)},
+      {2, 1, VK_FORMAT_R32G32B32A32_SFLOAT,
+       offsetof(Landscape, tileSidesHeight)},
+      {3, 1, VK_FORMAT_R32G32B32A32_SFLOAT,
+       offsetof(Landscape, tileCornersHeight)}};
   return attributeDescriptions;
 }
 
+// Cells of the checkpoint or pattern being loaded, otherwise cells alive at
+// random as initialize.comp seeds them on the device
 std::vector<World::Cell> World::initializeCells() {
-  const uint_fast16_t width = _control.grid.dimensions[0];
-  const uint_fast16_t height = _control.grid.dimensions[1];
-  const uint_fast32_t numGridPoints = width * height;
-  const uint_fast32_t numAliveCells = _control.grid.totalAliveCells;
-  const float gap = 0.6f;
-  std::array<float, 4> size = {tile.cubeSize};
-
-  if (numAliveCells > numGridPoints) {
-    throw std::runtime_error(
-        "\n!ERROR! Number of alive cells exceeds number of grid "
-        "points");
+  if (_checkpoint.isOpen()) {
+    return _checkpoint.readCells();
   }
-
-  std::vector<World::Cell> cells(numGridPoints);
-  std::vector<bool> isAliveIndices(numGridPoints, false);
-
-  for (uint_fast32_t i = 0; i < numGridPoints; i++) {
-    isAliveIndices.push_back(false);
-  }
-
-  std::vector<uint_fast32_t> aliveCellIndices =
-      _control.setCellsAliveRandomly(_control.grid.totalAliveCells);
-  for (int aliveIndex : aliveCellIndices) {
-    isAliveIndices[aliveIndex] = true;
+  if (_pattern.isOpen()) {
+    return _pattern.readCells();
   }
+  const uint32_t numGridPoints = static_cast<uint32_t>(
+      _control.grid.dimensions[0] * _control.grid.dimensions[1]);
+  const uint64_t key = Random::getKey(_control.grid.seed);
+  const uint32_t threshold = _control.getAliveThreshold();
+  _log.console("{ (X) }", "seeding cells with seed", _control.grid.seed);
 
-  std::vector<float> tileHeight =
-      setGridHeight(numGridPoints, 0.0f, _control.grid.height);
-
-  const std::array<float, 4> sidesHeight = {0.0f, 0.0f, 0.0f, 0.0f};
-  const std::array<float, 4> cornersHeight = {0.0f, 0.0f, 0.0f, 0.0f};
-
-  float startX = -((width - 1) * gap) / 2.0f;
-  float startY = -((height - 1) * gap) / 2.0f;
-
-  for (uint_fast32_t i = 0; i < numGridPoints; ++i) {
-    const uint_fast16_t x = static_cast<uint_fast16_t>(i % width);
-    const uint_fast16_t y = static_cast<uint_fast16_t>(i / width);
-    const float posX = startX + x * gap;
-    const float posY = startY + y * gap;
-
-    const std::array<float, 4> pos = {posX, posY, tileHeight[i], 1.0f};
-    const bool isAlive = isAliveIndices[i];
-
-    const std::array<float, 4>& color = isAlive ? blue : red;
-    const std::array<int, 4>& state = isAlive ? alive : dead;
-
-    cells[i] = {pos, color, size, state, sidesHeight, cornersHeight};
+  std::vector<World::Cell> cells(numGridPoints);
+  for (uint32_t i = 0; i < numGridPoints; i++) {
+    const uint32_t draw = Random::squares(
+        Random::getCounter(i, Random::Stream::alive), key);
+    cells[i].state = draw < threshold ? alive : dead;
   }
   return cells;
 }
 
-bool World::isIndexAlive(const std::vector<int>& aliveCells, int index) {
-  return std::find(aliveCells.begin(), aliveCells.end(), index) !=
-         aliveCells.end();
-}
-
 World::UniformBufferObject World::updateUniforms() {
   UniformBufferObject uniformObject{
       .light = light.position,
@@ -102,8 +69,14 @@ World::UniformBufferObject World::updateUniforms() {
       .gridHeight = _control.grid.height,
       .cellSize = tile.cubeSize,
       .model = setModel(),
-      .view = setView(),
-      .proj = setProjection(_mechanics.swapChain.extent)};
+      .view = glm::mat4(1.0f),
+      .proj = glm::mat4(1.0f)};
+
+  // Without a swap chain only the compute shaders read the grid fields
+  if (!_control.simulation.headless) {
+    uniformObject.view = setView();
+    uniformObject.proj = setProjection(_mechanics.swapChain.extent);
+  }
   return uniformObject;
 }
 
@@ -192,21 +165,6 @@ float World::getForwardMovement(const glm::vec2& leftButtonDelta) {
   return forwardMovement;
 }
 
-std::vector<float> World::setGridHeight(int amount, float min, float max) {
-  static std::random_device rd;
-  static std::mt19937 gen(rd());
-  std::uniform_real_distribution<float> dis(min, max);
-  std::vector<float> randomValues(amount);
-  int heightSteps = _control.grid.heightSteps;
-  int offset = 0;
-  for (size_t i = 0; i < amount; ++i) {
-    randomValues[i] = (dis(gen) * offset) / heightSteps;
-    offset = (offset + 1) % heightSteps;
-  }
-  std::shuffle(randomValues.begin(), randomValues.end(), gen);
-  return randomValues;
-}
-
 glm::mat4 World::setModel() {
   glm::mat4 model = glm::rotate(glm::mat4(1.0f), glm::radians(0.0f),
                                 glm::vec3(0.0f, 0.0f, 1.0f));
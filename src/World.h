@@ -28,11 +28,15 @@ class World {
     std::array<float, 4> position{0.0f, 2.0f, 10.0f, 0.0f};
   } light;
 
+  // Simulation state, ping-ponged by the compute pass every generation.
+  // bit 0 alive | bit 1 stage | bits 2-6 cycle | bit 7 seeded | 8-31 hour
   struct Cell {
+    uint32_t state;
+  };
+
+  // Render attributes that never change after initialization
+  struct Landscape {
     std::array<float, 4> position;
-    std::array<float, 4> color;
-    std::array<float, 4> size;
-    std::array<int, 4> states;
     std::array<float, 4> tileSidesHeight;
     std::array<float, 4> tileCornersHeight;
   };
@@ -58,7 +62,6 @@ class World {
   float getForwardMovement(const glm::vec2& leftButtonDelta);
 
   std::vector<World::Cell> initializeCells();
-  bool isIndexAlive(const std::vector<int>& aliveCells, int index);
 
   static std::vector<VkVertexInputAttributeDescription>
   getAttributeDescriptions();
@@ -69,11 +72,7 @@ class World {
   glm::mat4 setView();
   glm::mat4 setProjection(VkExtent2D& swapChainExtent);
 
-  std::vector<float> setGridHeight(int amount, float min, float max);
-
-  inline static const std::array<float, 4> red{1.0f, 0.0f, 0.0f, 1.0f};
-  inline static const std::array<float, 4> blue{0.0f, 0.0f, 1.0f, 1.0f};
-
-  inline static const std::array<int, 4> alive{1, 0, 0, 0};
-  inline static const std::array<int, 4> dead{-1, 0, 0, 0};
+  inline static const uint32_t seeded{1u << 7};
+  inline static const uint32_t alive{seeded | 1u};
+  inline static const uint32_t dead{seeded};
 };
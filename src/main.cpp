@@ -3,10 +3,15 @@
 
 #include "CapitalEngine.h"
 
-int main() {
+int main(int argc, char* argv[]) {
   try {
+    _control.parseArguments(argc, argv);
     CapitalEngine CAPITAL;
-    CAPITAL.mainLoop();
+    if (_control.simulation.headless) {
+      CAPITAL.runHeadless();
+    } else {
+      CAPITAL.mainLoop();
+    }
   } catch (const std::exception& e) {
     _log.console(e.what());
     return EXIT_FAILURE;